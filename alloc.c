@@ -0,0 +1,226 @@
+#define _GNU_SOURCE /* for dladdr */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+#include <dlfcn.h>
+#include "alloc.h"
+
+enum
+{
+    SITES_CAP = 512, /* Capacity of the table of call sites (power of 2) */
+};
+
+/* Call site and its allocations */
+typedef struct
+{
+    const void *site; /* Return address of the allocating call (NULL for empty entry) */
+    int kind; /* Kind of allocations */
+    long count; /* Number of allocations */
+    size_t bytes; /* Requested bytes */
+} AlSite;
+
+int al_on = 0;
+AlTotals al_totals = { { 0 }, { 0 } };
+
+/* Table of call sites of the current period (open addressing and linear probing);
+ * if it is full, allocations of new sites are added to al_other */
+AlSite al_sites[SITES_CAP];
+int al_sites_count = 0;
+AlSite al_other = { NULL, AL_HEAP, 0, 0 };
+
+/* Live heap bytes (usable sizes of blocks) and their peak since al_take_peak or al_reset */
+size_t al_live = 0;
+size_t al_peak = 0;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+/* The function adds heap block 'ptr' to live bytes */
+void _al_live_add(void *ptr);
+
+/* The function adds 'count' allocations of 'size' bytes of kind 'kind' of call site 'site' */
+void _al_add(int kind, const void *site, long count, size_t size);
+
+/* The function compares call sites by bytes in descending order (for qsort) */
+int _al_cmp(const void *a, const void *b);
+
+/* The function prints call site 'st' */
+void _al_print_site(const AlSite *st);
+
+void
+_al_live_add(void *ptr)
+{
+    al_live += malloc_usable_size(ptr);
+    if (al_live > al_peak) {
+        al_peak = al_live;
+    }
+}
+
+void *
+__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    if (al_on && ptr != NULL) {
+        al_note(AL_HEAP, __builtin_return_address(0), size);
+        _al_live_add(ptr);
+    }
+    return ptr;
+}
+
+void *
+__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    if (al_on && ptr != NULL) {
+        al_note(AL_HEAP, __builtin_return_address(0), count * size);
+        _al_live_add(ptr);
+    }
+    return ptr;
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    if (!al_on) {
+        return __real_realloc(ptr, size);
+    }
+    const size_t old = ptr == NULL ? 0 : malloc_usable_size(ptr);
+    void *res = __real_realloc(ptr, size);
+    if (res != NULL) {
+        al_note(AL_HEAP, __builtin_return_address(0), size);
+        al_live -= old < al_live ? old : al_live;
+        _al_live_add(res);
+    }
+    return res;
+}
+
+void
+__wrap_free(void *ptr)
+{
+    if (al_on && ptr != NULL) {
+        /* Blocks allocated before accounting was turned on are not counted as live */
+        const size_t size = malloc_usable_size(ptr);
+        al_live -= size < al_live ? size : al_live;
+    }
+    __real_free(ptr);
+}
+
+void
+al_enable(int on)
+{
+    al_on = on;
+}
+
+void
+al_note(int kind, const void *site, size_t size)
+{
+    _al_add(kind, site, 1, size);
+}
+
+void
+al_note_grow(int kind, const void *site, size_t size)
+{
+    _al_add(kind, site, 0, size);
+}
+
+void
+_al_add(int kind, const void *site, long count, size_t size)
+{
+    al_totals.count[kind] += count;
+    al_totals.bytes[kind] += size;
+
+    register unsigned i = ((uintptr_t)site >> 2) & (SITES_CAP - 1);
+    while (al_sites[i].site != NULL && (al_sites[i].site != site || al_sites[i].kind != kind)) {
+        i = (i + 1) & (SITES_CAP - 1);
+    }
+    AlSite *st = al_sites + i;
+    if (st->site == NULL) {
+        /* The table is kept at most half full */
+        if (2 * (al_sites_count + 1) > SITES_CAP) {
+            st = &al_other;
+        } else {
+            st->site = site;
+            st->kind = kind;
+            ++al_sites_count;
+        }
+    }
+    st->count += count;
+    st->bytes += size;
+}
+
+void
+al_get(AlTotals *t)
+{
+    *t = al_totals;
+}
+
+void
+al_reset(void)
+{
+    memset(al_sites, 0, sizeof(al_sites));
+    al_sites_count = 0;
+    al_other.count = 0;
+    al_other.bytes = 0;
+    al_peak = al_live;
+}
+
+size_t
+al_take_peak(void)
+{
+    const size_t peak = al_peak;
+    al_peak = al_live;
+    return peak;
+}
+
+int
+_al_cmp(const void *a, const void *b)
+{
+    const size_t ba = ((const AlSite *)a)->bytes;
+    const size_t bb = ((const AlSite *)b)->bytes;
+    return ba < bb ? 1 : ba > bb ? -1 : 0;
+}
+
+void
+_al_print_site(const AlSite *st)
+{
+    Dl_info info;
+    printf("    %-6s %8ld %12zu  ", st->kind == AL_HEAP ? "heap" : "arena", st->count, st->bytes);
+    if (st->site == NULL) {
+        printf("(other sites)\n");
+    } else if (dladdr(st->site, &info) && info.dli_sname != NULL) {
+        printf("%s+0x%lx\n", info.dli_sname, (unsigned long)((const char *)st->site - (const char *)info.dli_saddr));
+    } else {
+        printf("%p\n", st->site);
+    }
+}
+
+void
+al_print(int max_sites)
+{
+    /* Sites are copied, so that printing (which may allocate) does not change the table */
+    const int was_on = al_on;
+    al_on = 0;
+    AlSite sites[SITES_CAP];
+    int n = 0;
+    for (int i = 0; i < SITES_CAP; ++i) {
+        if (al_sites[i].site != NULL) {
+            sites[n++] = al_sites[i];
+        }
+    }
+    qsort(sites, n, sizeof(*sites), _al_cmp);
+
+    printf("    %-6s %8s %12s  %s\n", "kind", "count", "bytes", "call site");
+    for (int i = 0; i < n && i < max_sites; ++i) {
+        _al_print_site(sites + i);
+    }
+    if (al_other.count > 0) {
+        _al_print_site(&al_other);
+    }
+
+    al_reset();
+    al_on = was_on;
+}
@@ -0,0 +1,49 @@
+/* The module implements accounting of allocations of the shell (flag 512):
+ * malloc, calloc, realloc and free are wrapped at link time (see Makefile), and functions of arena report
+ * their allocations here; each allocation is attributed to its call site (the function which requested it);
+ * when accounting is off, a wrapped call costs only one check of a flag */
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+enum ALKINDS /* Kinds of allocations */
+{
+    AL_HEAP = 0, /* malloc, calloc or realloc */
+    AL_ARENA = 1, /* Allocation in an arena */
+    AL_KINDS = 2, /* Number of kinds */
+};
+
+typedef struct al_totals AlTotals;
+struct al_totals
+{
+    long count[AL_KINDS]; /* Number of allocations of each kind */
+    size_t bytes[AL_KINDS]; /* Requested bytes of allocations of each kind */
+};
+
+/* Whether accounting is on */
+extern int al_on;
+
+/* Turns accounting on (if 'on' is set) or off */
+void al_enable(int on);
+
+/* Records allocation of 'size' bytes of kind 'kind' requested by call site 'site' (a return address) */
+void al_note(int kind, const void *site, size_t size);
+
+/* Records growth of an allocation in place by 'size' bytes: bytes are added, but the number of allocations is not */
+void al_note_grow(int kind, const void *site, size_t size);
+
+/* Writes totals of all recorded allocations to '*t' */
+void al_get(AlTotals *t);
+
+/* Starts a new period: forgets call sites and peak of live heap bytes (totals are kept) */
+void al_reset(void);
+
+/* Returns peak of live heap bytes since the previous call or al_reset and starts a new peak from live bytes
+ * (it is taken at the end of each phase of a line) */
+size_t al_take_peak(void);
+
+/* Prints up to 'max_sites' call sites with most allocated bytes in the current period, and starts a new period */
+void al_print(int max_sites);
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "arena.h"
+#include "alloc.h"
+
+enum
+{
+    BLOCK_SIZE = 4096, /* Minimal size of a block */
+    KEEP_MAX = 1 << 20, /* Maximal size of memory kept by ar_reset */
+};
+
+/* Block of memory; blocks of arena form a list from the newest to the oldest */
+typedef struct ar_block ArBlock;
+struct ar_block
+{
+    ArBlock *prev; /* Previous block */
+    size_t size; /* Size of data */
+    size_t used; /* Number of used bytes of data */
+    max_align_t data[]; /* Data (aligned for any type) */
+};
+
+struct arena
+{
+    ArBlock *cur; /* Current block */
+    size_t total; /* Total size of all blocks */
+};
+
+/* Rounds 'size' up to the alignment of any type */
+#define ALIGN(size) (((size) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+/* Records allocation of 'size' bytes by the caller of an arena function (if accounting of allocations is on) */
+#define AR_NOTE(size) do { if (al_on) al_note(AL_ARENA, __builtin_return_address(0), (size)); } while (0)
+
+/* Records growth of the last allocation of the caller in place by 'size' bytes (if accounting is on) */
+#define AR_NOTE_GROW(size) do { if (al_on) al_note_grow(AL_ARENA, __builtin_return_address(0), (size)); } while (0)
+
+/* The function allocates 'size' bytes in arena (without accounting) */
+void * _ar_alloc(Arena *ar, size_t size);
+
+/* The function adds a new block of at least 'size' bytes to arena */
+void _ar_add_block(Arena *ar, size_t size);
+
+/* The function frees all blocks of arena */
+void _ar_free_blocks(Arena *ar);
+
+void
+_ar_add_block(Arena *ar, size_t size)
+{
+    /* Blocks grow geometrically, so their number is logarithmic */
+    size_t bsize = ar->cur == NULL ? BLOCK_SIZE : ar->cur->size * 2;
+    if (bsize < size) {
+        bsize = size;
+    }
+    ArBlock *blk = malloc(sizeof(*blk) + bsize);
+    blk->prev = ar->cur;
+    blk->size = bsize;
+    blk->used = 0;
+    ar->cur = blk;
+    ar->total += bsize;
+}
+
+void
+_ar_free_blocks(Arena *ar)
+{
+    while (ar->cur != NULL) {
+        ArBlock *prev = ar->cur->prev;
+        free(ar->cur);
+        ar->cur = prev;
+    }
+    ar->total = 0;
+}
+
+Arena *
+ar_init(void)
+{
+    Arena *ar = calloc(1, sizeof(*ar));
+    _ar_add_block(ar, BLOCK_SIZE);
+    return ar;
+}
+
+void *
+_ar_alloc(Arena *ar, size_t size)
+{
+    assert(ar != NULL);
+
+    size = ALIGN(size);
+    if (ar->cur->size - ar->cur->used < size) {
+        _ar_add_block(ar, size);
+    }
+    void *ptr = (char *)ar->cur->data + ar->cur->used;
+    ar->cur->used += size;
+    return ptr;
+}
+
+void *
+ar_alloc(Arena *ar, size_t size)
+{
+    AR_NOTE(size);
+    return _ar_alloc(ar, size);
+}
+
+void *
+ar_calloc(Arena *ar, size_t count, size_t size)
+{
+    AR_NOTE(count * size);
+    void *ptr = _ar_alloc(ar, count * size);
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *
+ar_realloc(Arena *ar, void *ptr, size_t old_size, size_t new_size)
+{
+    assert(ar != NULL);
+
+    if (ptr == NULL) {
+        AR_NOTE(new_size);
+        return _ar_alloc(ar, new_size);
+    }
+    /* If 'ptr' is the last allocation and there is enough space after it, grows it in place,
+     * and only the added bytes are counted */
+    char *data = (char *)ar->cur->data;
+    if ((char *)ptr + ALIGN(old_size) == data + ar->cur->used &&
+            (char *)ptr - data + ALIGN(new_size) <= ar->cur->size) {
+        AR_NOTE_GROW(new_size > old_size ? new_size - old_size : 0);
+        ar->cur->used = (char *)ptr - data + ALIGN(new_size);
+        return ptr;
+    }
+    /* Otherwise moves data (old memory is freed with the arena), which is one allocation of 'new_size' */
+    AR_NOTE(new_size);
+    void *res = _ar_alloc(ar, new_size);
+    memcpy(res, ptr, old_size < new_size ? old_size : new_size);
+    return res;
+}
+
+char *
+ar_strndup(Arena *ar, const char *str, size_t len)
+{
+    AR_NOTE(len + 1);
+    char *res = _ar_alloc(ar, len + 1);
+    memcpy(res, str, len);
+    res[len] = '\0';
+    return res;
+}
+
+char *
+ar_strdup(Arena *ar, const char *str)
+{
+    const size_t len = strlen(str);
+    AR_NOTE(len + 1);
+    char *res = _ar_alloc(ar, len + 1);
+    memcpy(res, str, len + 1);
+    return res;
+}
+
+size_t
+ar_size(Arena *ar)
+{
+    assert(ar != NULL);
+
+    return ar->total;
+}
+
+void
+ar_reset(Arena *ar)
+{
+    assert(ar != NULL);
+
+    if (ar->cur->prev == NULL) {
+        ar->cur->used = 0;
+        return;
+    }
+    /* If arena has several blocks, replaces them by one block which fits all of them,
+     * but does not keep more than KEEP_MAX bytes */
+    size_t total = ar->total;
+    _ar_free_blocks(ar);
+    _ar_add_block(ar, total <= KEEP_MAX ? total : BLOCK_SIZE);
+}
+
+void
+ar_delete(Arena **par)
+{
+    assert(par != NULL);
+    assert(*par != NULL);
+
+    _ar_free_blocks(*par);
+    free(*par);
+    *par = NULL;
+}
@@ -0,0 +1,39 @@
+/* The module implements arena (bump) allocator:
+ * memory is taken from large blocks by moving a pointer and is freed all at once */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena Arena;
+
+/* Creates empty arena and returns it */
+Arena * ar_init(void);
+
+/* Allocates 'size' bytes in arena 'ar' and returns pointer to them */
+void * ar_alloc(Arena *ar, size_t size);
+
+/* Allocates zeroed memory for 'count' elements of size 'size' in arena 'ar' and returns pointer to it */
+void * ar_calloc(Arena *ar, size_t count, size_t size);
+
+/* Changes size of memory block 'ptr' allocated in arena 'ar' from 'old_size' to 'new_size' and returns
+ * new pointer to it; if 'ptr' is the last allocation in arena, it grows in place */
+void * ar_realloc(Arena *ar, void *ptr, size_t old_size, size_t new_size);
+
+/* Allocates a copy of the first 'len' characters of string 'str' in arena 'ar' and returns it */
+char * ar_strndup(Arena *ar, const char *str, size_t len);
+
+/* Allocates a copy of string 'str' in arena 'ar' and returns it */
+char * ar_strdup(Arena *ar, const char *str);
+
+/* Returns total size of memory blocks of arena 'ar' */
+size_t ar_size(Arena *ar);
+
+/* Frees all memory allocated in arena 'ar' at once;
+ * memory is kept for the next allocations, so the same amount can be allocated again without malloc */
+void ar_reset(Arena *ar);
+
+/* Deletes arena '*par' and sets it to NULL */
+void ar_delete(Arena **par);
+
+#endif
@@ -0,0 +1,112 @@
+/* Benchmark of command launch: fork + exec against posix_spawn at different resident sizes of the shell
+ * Usage: ./bench [launches] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+
+enum
+{
+    LAUNCHES_DFLT = 500, /* Default number of launches for each measurement */
+    MIB = 1 << 20,
+};
+
+extern char **environ;
+
+const char CMD_PATH[] = "/bin/true";
+
+/* Resident sizes of the process (in MiB) for measurements */
+const int RSS_SIZES[] = {0, 64, 256, 1024, -1};
+
+/* The function returns current time in microseconds */
+double _now_us(void);
+
+/* The function launches command by fork + execv and waits it */
+void _launch_fork(char **argv);
+
+/* The function launches command by posix_spawn and waits it */
+void _launch_spawn(char **argv);
+
+/* The function returns average time of one launch in microseconds */
+double _measure(void (*launch)(char **argv), char **argv, int launches);
+
+double
+_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void
+_launch_fork(char **argv)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    } else if (!pid) {
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+void
+_launch_spawn(char **argv)
+{
+    pid_t pid;
+    if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ)) {
+        perror("posix_spawn");
+        exit(1);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+double
+_measure(void (*launch)(char **argv), char **argv, int launches)
+{
+    launch(argv); /* Warms up */
+    const double begin = _now_us();
+    for (int i = 0; i < launches; ++i) {
+        launch(argv);
+    }
+    return (_now_us() - begin) / launches;
+}
+
+int
+main(int argc, char **argv)
+{
+    const int launches = argc > 1 ? atoi(argv[1]) : LAUNCHES_DFLT;
+    if (launches <= 0) {
+        fprintf(stderr, "Usage: %s [launches]\n", argv[0]);
+        return 1;
+    }
+
+    char *cmd[] = {(char *)CMD_PATH, NULL};
+    printf("%s, %d launches, average time of one launch\n", CMD_PATH, launches);
+    printf("%10s %12s %12s\n", "RSS, MiB", "fork, us", "spawn, us");
+    for (int i = 0; RSS_SIZES[i] != -1; ++i) {
+        /* Touches the memory, so that it is resident and has page tables */
+        char *mem = NULL;
+        if (RSS_SIZES[i]) {
+            mem = malloc((size_t)RSS_SIZES[i] * MIB);
+            if (mem == NULL) {
+                fprintf(stderr, "Can not allocate %d MiB\n", RSS_SIZES[i]);
+                break;
+            }
+            memset(mem, 1, (size_t)RSS_SIZES[i] * MIB);
+        }
+
+        const double t_fork = _measure(_launch_fork, cmd, launches);
+        const double t_spawn = _measure(_launch_spawn, cmd, launches);
+        printf("%10d %12.1f %12.1f\n", RSS_SIZES[i], t_fork, t_spawn);
+        fflush(stdout);
+
+        free(mem);
+    }
+    return 0;
+}
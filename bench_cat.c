@@ -0,0 +1,129 @@
+/* Benchmark of data moving by the shell: plain cat stages (moved by the kernel in the shell)
+ * against /bin/cat (spawned), on a file of given size; the shell ./r must be built
+ * Usage: ./bench_cat [size in MiB] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+
+enum
+{
+    SIZE_DFLT = 2048, /* Default size of the file in MiB */
+    MIB = 1 << 20,
+    LINE_SIZE = 256, /* Size of buffer of a command line */
+};
+
+extern char **environ;
+
+const char SHELL_PATH[] = "./r";
+const char DATA_FN[] = "bench_cat.dat";
+const char OUT_FN[] = "bench_cat.out";
+const char SCRIPT_FN[] = "bench_cat.sh";
+
+/* Measured command lines: %1$s is the data file, %2$s is the output file, %3$s is the cat */
+const char * const CASES[] = {
+    "%3$s %1$s > %2$s", /* file to file */
+    "%3$s < %1$s > /dev/null", /* file to device */
+    "%3$s %1$s | %3$s > %2$s", /* file to pipe, pipe to file */
+    NULL,
+};
+
+/* The function returns current time in seconds */
+double _now(void);
+
+/* The function creates data file of 'size' MiB; returns 0 or -1 in case of an error */
+int _make_data(int size);
+
+/* The function executes command line 'line' by the shell and returns its time in seconds */
+double _run(const char *line);
+
+double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+_make_data(int size)
+{
+    char *block = malloc(MIB);
+    for (int i = 0; i < MIB; ++i) {
+        block[i] = 'a' + i % 26;
+    }
+    block[MIB - 1] = '\n';
+    const int fd = open(DATA_FN, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int ret = fd == -1 ? -1 : 0;
+    for (int i = 0; ret == 0 && i < size; ++i) {
+        if (write(fd, block, MIB) != MIB) {
+            ret = -1;
+        }
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    free(block);
+    return ret;
+}
+
+double
+_run(const char *line)
+{
+    FILE *f = fopen(SCRIPT_FN, "w");
+    fprintf(f, "%s\n", line);
+    fclose(f);
+
+    char *argv[] = {(char *)SHELL_PATH, "16", (char *)SCRIPT_FN, NULL};
+    const double begin = _now();
+    pid_t pid;
+    if (posix_spawn(&pid, SHELL_PATH, NULL, NULL, argv, environ)) {
+        perror("posix_spawn");
+        exit(1);
+    }
+    waitpid(pid, NULL, 0);
+    return _now() - begin;
+}
+
+int
+main(int argc, char **argv)
+{
+    const int size = argc > 1 ? atoi(argv[1]) : SIZE_DFLT;
+    if (size <= 0) {
+        fprintf(stderr, "Usage: %s [size in MiB]\n", argv[0]);
+        return 1;
+    }
+    if (access(SHELL_PATH, X_OK) != 0) {
+        fprintf(stderr, "%s is not built\n", SHELL_PATH);
+        return 1;
+    }
+    if (_make_data(size) == -1) {
+        fprintf(stderr, "Can not create %d MiB file %s\n", size, DATA_FN);
+        unlink(DATA_FN);
+        return 1;
+    }
+
+    printf("%d MiB, throughput in MiB/s\n", size);
+    printf("%-36s %12s %12s\n", "command", "/bin/cat", "cat");
+    char line[LINE_SIZE];
+    for (int i = 0; CASES[i] != NULL; ++i) {
+        /* The first run warms up page cache */
+        snprintf(line, LINE_SIZE, CASES[i], DATA_FN, OUT_FN, "/bin/cat");
+        _run(line);
+        const double t_spawn = _run(line);
+        snprintf(line, LINE_SIZE, CASES[i], DATA_FN, OUT_FN, "cat");
+        const double t_move = _run(line);
+        snprintf(line, LINE_SIZE, CASES[i], "F", "OUT", "cat");
+        printf("%-36s %12.0f %12.0f\n", line, size / t_spawn, size / t_move);
+        fflush(stdout);
+    }
+
+    unlink(DATA_FN);
+    unlink(OUT_FN);
+    unlink(SCRIPT_FN);
+    return 0;
+}
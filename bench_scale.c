@@ -0,0 +1,235 @@
+/* Scaling test of the parser on pathological lines: a long single word, a command with many arguments,
+ * a long && chain, deep brackets and many variable references; each line is run through parse, st_build,
+ * pg_compile and expansion of variables in words of the program (as shell_run does before each command)
+ * at sizes which double up to the maximal one, and the test fails (exit status 1) if time or bytes allocated
+ * in arenas (the parser allocates only there, and blocks of an arena are proportional to them)
+ * at the maximal size exceed the linear growth from the smallest size more than SLACK times;
+ * it is linked with the modules compiled with optimization (see target bench_scale in Makefile)
+ * Usage: ./bench_scale [seconds per measurement] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "strarr.h"
+#include "lexer.h"
+#include "shelltree.h"
+#include "parse.h"
+#include "program.h"
+#include "vars.h"
+#include "alloc.h"
+
+enum
+{
+    DOUBLINGS = 3, /* The smallest size is the maximal one divided by 2^DOUBLINGS */
+    RUNS = 3, /* Number of measurements of each size (the fastest one is taken) */
+    SLACK = 2, /* Allowed excess of growth over the linear one (quadratic growth gives 2^DOUBLINGS) */
+    LINE_MAX_SIZE = 1 << 21, /* Size of buffer of a generated line */
+};
+
+const double TIME_DFLT = 0.05; /* Default time of one measurement in seconds */
+
+const char BASH_NAME[] = "bench_scale";
+
+extern char **environ;
+
+/* Case of the test: name, maximal size and generator of a line of size 'n' in 'buf' */
+typedef struct
+{
+    const char *name;
+    int max;
+    void (*gen)(char *buf, int n);
+} ScCase;
+
+/* Line of the current measurement and the arena which is reset after each operation */
+Arena *sc_ar = NULL;
+const char *sc_line = NULL;
+
+/* The function returns current time in seconds */
+double _now(void);
+
+/* The function returns time of one operation on the current line in seconds
+ * and writes bytes allocated by it in arenas to '*pbytes' */
+double _measure(double time, size_t *pbytes);
+
+/* The function measures case 'c' at growing sizes, prints them and returns 0 or 1 if growth is not linear */
+int _check(const ScCase *c, char *buf, double time);
+
+/* The function parses the current line, builds and compiles its tree and expands its words */
+void _op(void);
+
+/* Generators of lines of size 'n' */
+void _gen_word(char *buf, int n);
+void _gen_args(char *buf, int n);
+void _gen_chain(char *buf, int n);
+void _gen_brackets(char *buf, int n);
+void _gen_vars(char *buf, int n);
+
+const ScCase CASES[] = {
+    {"word (bytes)", 1 << 20, _gen_word},
+    {"arguments", 100000, _gen_args},
+    {"&& chain", 10000, _gen_chain},
+    {"brackets (depth)", 10000, _gen_brackets},
+    {"$VAR references", 50000, _gen_vars},
+    {NULL, 0, NULL},
+};
+
+double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+_op(void)
+{
+    /* The lexer terminates words in place, so it gets a fresh copy of the line */
+    Token *toks;
+    const int count = parse(ar_strdup(sc_ar, sc_line), &toks, sc_ar);
+    Program *prog = pg_compile(st_build(toks, count, sc_ar), sc_ar);
+    for (int i = 0; i < prog->len; ++i) {
+        const Instr *in = prog->code + i;
+        if (!in->expand) {
+            continue;
+        }
+        if (in->op == OP_REDIR) {
+            lex_expand(in->file, sc_ar);
+            continue;
+        }
+        for (int j = 0; in->argv[j] != NULL; ++j) {
+            lex_expand(in->argv[j], sc_ar);
+        }
+    }
+    ar_reset(sc_ar);
+}
+
+double
+_measure(double time, size_t *pbytes)
+{
+    AlTotals before, after;
+    al_get(&before);
+    al_enable(1);
+    _op();
+    al_enable(0);
+    al_get(&after);
+    al_reset();
+    *pbytes = after.bytes[AL_ARENA] - before.bytes[AL_ARENA];
+
+    double best = 0;
+    for (int r = 0; r < RUNS; ++r) {
+        long ops = 0;
+        const double begin = _now();
+        double elapsed;
+        while ((elapsed = _now() - begin) < time) {
+            _op();
+            ++ops;
+        }
+        if (r == 0 || elapsed / ops < best) {
+            best = elapsed / ops;
+        }
+    }
+    return best;
+}
+
+int
+_check(const ScCase *c, char *buf, double time)
+{
+    double t_min = 0;
+    size_t b_min = 0;
+    double t_ratio = 0;
+    double b_ratio = 0;
+    for (int i = DOUBLINGS; i >= 0; --i) {
+        const int n = c->max >> i;
+        c->gen(buf, n);
+        sc_line = buf;
+        size_t bytes;
+        const double t = _measure(time, &bytes);
+        if (i == DOUBLINGS) {
+            t_min = t;
+            b_min = bytes;
+        }
+        t_ratio = t / t_min;
+        b_ratio = (double)bytes / b_min;
+        printf("%-20s %8d %14.0f %12zu %10.2f %10.2f\n", c->name, n, t * 1e9, bytes, t_ratio, b_ratio);
+        fflush(stdout);
+    }
+
+    const double limit = SLACK * (1 << DOUBLINGS);
+    if (t_ratio > limit || b_ratio > limit) {
+        printf("%s: growth of %s is not linear (allowed ratio is %.0f)\n", BASH_NAME, c->name, limit);
+        return 1;
+    }
+    return 0;
+}
+
+void
+_gen_word(char *buf, int n)
+{
+    strcpy(buf, "echo ");
+    memset(buf + 5, 'a', n);
+    buf[5 + n] = '\0';
+}
+
+void
+_gen_args(char *buf, int n)
+{
+    char *p = buf + sprintf(buf, "echo");
+    for (int i = 0; i < n; ++i) {
+        p += sprintf(p, " a%d", i % 1000);
+    }
+}
+
+void
+_gen_chain(char *buf, int n)
+{
+    char *p = buf;
+    for (int i = 0; i < n; ++i) {
+        p += sprintf(p, i == 0 ? "true" : " && true");
+    }
+}
+
+void
+_gen_brackets(char *buf, int n)
+{
+    memset(buf, '(', n);
+    strcpy(buf + n, "true");
+    memset(buf + n + 4, ')', n);
+    buf[2 * n + 4] = '\0';
+}
+
+void
+_gen_vars(char *buf, int n)
+{
+    char *p = buf + sprintf(buf, "echo");
+    for (int i = 0; i < n; ++i) {
+        p += sprintf(p, i % 2 == 0 ? " $SCALE_VAR" : " x${SCALE_VAR}y");
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const double time = argc > 1 ? atof(argv[1]) : TIME_DFLT;
+    if (time <= 0) {
+        fprintf(stderr, "Usage: %s [seconds per measurement]\n", argv[0]);
+        return 1;
+    }
+    sc_ar = ar_init();
+    vr_init(environ);
+    vr_set("SCALE_VAR", "value", 0);
+
+    char *buf = malloc(LINE_MAX_SIZE);
+    printf("%-20s %8s %14s %12s %10s %10s\n", "case", "n", "ns/op", "bytes/op", "time x", "bytes x");
+    int ret = 0;
+    for (int i = 0; CASES[i].name != NULL; ++i) {
+        ret |= _check(CASES + i, buf, time);
+    }
+    printf("%s\n", ret ? "FAILED" : "OK");
+
+    free(buf);
+    vr_delete();
+    ar_delete(&sc_ar);
+    return ret;
+}
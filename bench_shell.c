@@ -0,0 +1,329 @@
+/* Microbenchmarks of the shell modules: string arrays, lexer, tree builder and executor;
+ * it is linked with the modules compiled with optimization, and fork and posix_spawn are wrapped
+ * (see target bench_shell in Makefile), so that started processes are counted;
+ * allocations are counted by module alloc in a separate run, so that accounting does not affect time
+ * Usage: ./bench_shell [seconds per measurement] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <time.h>
+#include "arena.h"
+#include "strarr.h"
+#include "lexer.h"
+#include "shelltree.h"
+#include "program.h"
+#include "shellexec.h"
+#include "parse.h"
+#include "jobs.h"
+#include "vars.h"
+#include "alloc.h"
+
+enum
+{
+    LINE_MAX_WORDS = 1 << 16, /* Maximal number of words of a generated line */
+    WORD_SIZE = 16, /* Maximal size of a generated word with its separator */
+    ALLOC_RUNS = 4, /* Number of operations of the run which counts allocations */
+};
+
+const double TIME_DFLT = 0.2; /* Default time of one measurement in seconds */
+
+const char BASH_NAME[] = "bench_shell";
+
+extern char **environ;
+
+/* Sizes of measured data */
+const int ARR_SIZES[] = {16, 256, 4096, -1};
+const int LINE_SIZES[] = {16, 256, 4096, 65536, -1};
+const int DEPTHS[] = {10, 100, 1000, -1};
+const int STAGES[] = {1, 4, 16, -1};
+
+/* Counter of the wrapped functions which start processes */
+long bench_procs = 0;
+
+pid_t __real_fork(void);
+int __real_posix_spawn(pid_t *pid, const char *path, const posix_spawn_file_actions_t *fa,
+        const posix_spawnattr_t *attr, char * const argv[], char * const envp[]);
+
+/* State of the current measurement: prepared data and the arena which is reset after each operation */
+Arena *bench_ar = NULL;
+Arena *bench_data_ar = NULL;
+strarr bench_arr = NULL;
+char *bench_line = NULL;
+Token *bench_toks = NULL;
+int bench_count = 0;
+Program *bench_prog = NULL;
+
+/* The function returns current time in seconds */
+double _now(void);
+
+/* The function repeats operation 'op' of size 'n' for at least 'time' seconds
+ * and prints its name, time, allocations (on heap and in arenas) and started processes per operation */
+void _measure(const char *name, int n, void (*op)(int n), double time);
+
+/* The function writes to 'buf' a line of 'words' words joined by operators of pipelines and lists */
+void _gen_line(char *buf, int words);
+
+/* The function writes to 'buf' a line of 'depth' commands joined by && */
+void _gen_chain(char *buf, int depth);
+
+/* The function writes to 'buf' a command in 'depth' nested brackets */
+void _gen_brackets(char *buf, int depth);
+
+/* The function writes to 'buf' a pipeline of 'stages' external commands */
+void _gen_pipeline(char *buf, int stages);
+
+/* The function writes to 'buf' 'jobs' background commands followed by builtin wait */
+void _gen_fanout(char *buf, int jobs);
+
+/* The function splits 'line' into tokens in the data arena (for st_build measurements) */
+void _prepare_toks(const char *line);
+
+/* The function compiles 'line' in the data arena (for shell_run measurements) */
+void _prepare_prog(const char *line);
+
+/* The function does nothing (it is called in son if execution is failed) */
+void _emerg(void);
+
+/* Measured operations */
+void _op_strarr_add(int n);
+void _op_strarr_cp(int n);
+void _op_parse(int n);
+void _op_build(int n);
+void _op_run(int n);
+
+pid_t
+__wrap_fork(void)
+{
+    ++bench_procs;
+    return __real_fork();
+}
+
+int
+__wrap_posix_spawn(pid_t *pid, const char *path, const posix_spawn_file_actions_t *fa,
+        const posix_spawnattr_t *attr, char * const argv[], char * const envp[])
+{
+    ++bench_procs;
+    return __real_posix_spawn(pid, path, fa, attr, argv, envp);
+}
+
+double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+_measure(const char *name, int n, void (*op)(int n), double time)
+{
+    op(n); /* Warms up */
+    long ops = 0;
+    const long procs = bench_procs;
+    const double begin = _now();
+    double elapsed;
+    /* The number of operations between time checks doubles, so that clock_gettime is not measured */
+    for (long batch = 1; (elapsed = _now() - begin) < time; batch *= 2) {
+        for (long i = 0; i < batch; ++i) {
+            op(n);
+        }
+        ops += batch;
+    }
+    const double procs_op = (double)(bench_procs - procs) / ops;
+
+    AlTotals before, after;
+    al_get(&before);
+    al_enable(1);
+    for (int i = 0; i < ALLOC_RUNS; ++i) {
+        op(n);
+    }
+    al_enable(0);
+    al_get(&after);
+    /* Sites of the run are not needed */
+    al_reset();
+
+    printf("%-24s %8d %10ld %14.0f %10.2f %10.2f %10.2f\n", name, n, ops, elapsed * 1e9 / ops,
+            (double)(after.count[AL_HEAP] - before.count[AL_HEAP]) / ALLOC_RUNS,
+            (double)(after.count[AL_ARENA] - before.count[AL_ARENA]) / ALLOC_RUNS, procs_op);
+    fflush(stdout);
+}
+
+void
+_gen_line(char *buf, int words)
+{
+    static const char * const OPS[] = {" ", " ", " | ", " && ", " ; ", " || ", " > "};
+    const int ops_count = sizeof(OPS) / sizeof(*OPS);
+    char *p = buf;
+    for (int i = 0; i < words; ++i) {
+        p += sprintf(p, "%sw%d", i == 0 ? "" : OPS[i % ops_count], i % 1000);
+    }
+}
+
+void
+_gen_chain(char *buf, int depth)
+{
+    char *p = buf;
+    for (int i = 0; i < depth; ++i) {
+        p += sprintf(p, i == 0 ? "true" : " && true");
+    }
+}
+
+void
+_gen_brackets(char *buf, int depth)
+{
+    memset(buf, '(', depth);
+    strcpy(buf + depth, "true");
+    memset(buf + depth + 4, ')', depth);
+    buf[2 * depth + 4] = '\0';
+}
+
+void
+_gen_pipeline(char *buf, int stages)
+{
+    char *p = buf;
+    for (int i = 0; i < stages; ++i) {
+        p += sprintf(p, i == 0 ? "/bin/true" : " | /bin/true");
+    }
+}
+
+void
+_gen_fanout(char *buf, int jobs)
+{
+    char *p = buf;
+    for (int i = 0; i < jobs; ++i) {
+        p += sprintf(p, "/bin/true & ");
+    }
+    strcpy(p, "wait");
+}
+
+void
+_prepare_toks(const char *line)
+{
+    ar_reset(bench_data_ar);
+    bench_count = lex(ar_strdup(bench_data_ar, line), &bench_toks, bench_data_ar);
+}
+
+void
+_prepare_prog(const char *line)
+{
+    ar_reset(bench_data_ar);
+    Token *toks;
+    const int count = lex(ar_strdup(bench_data_ar, line), &toks, bench_data_ar);
+    bench_prog = pg_compile(st_build(toks, count, bench_data_ar), bench_data_ar);
+}
+
+void
+_emerg(void)
+{
+}
+
+void
+_op_strarr_add(int n)
+{
+    strarr arr = strarr_init();
+    for (int i = 0; i < n; ++i) {
+        strarr_add(&arr, "argument");
+    }
+    strarr_del(&arr);
+}
+
+void
+_op_strarr_cp(int n)
+{
+    (void)n;
+    strarr copy = strarr_cp(bench_arr);
+    strarr_del(&copy);
+}
+
+void
+_op_parse(int n)
+{
+    (void)n;
+    /* The lexer terminates words in place, so it gets a fresh copy of the line */
+    Token *toks;
+    parse(ar_strdup(bench_ar, bench_line), &toks, bench_ar);
+    ar_reset(bench_ar);
+}
+
+void
+_op_build(int n)
+{
+    (void)n;
+    st_build(bench_toks, bench_count, bench_ar);
+    ar_reset(bench_ar);
+}
+
+void
+_op_run(int n)
+{
+    (void)n;
+    shell_run(bench_prog, _emerg);
+}
+
+int
+main(int argc, char **argv)
+{
+    const double time = argc > 1 ? atof(argv[1]) : TIME_DFLT;
+    if (time <= 0) {
+        fprintf(stderr, "Usage: %s [seconds per measurement]\n", argv[0]);
+        return 1;
+    }
+    bench_ar = ar_init();
+    bench_data_ar = ar_init();
+    vr_init(environ);
+    jb_init(0);
+
+    char *buf = malloc(LINE_MAX_WORDS * WORD_SIZE);
+    printf("%-24s %8s %10s %14s %10s %10s %10s\n", "operation", "n", "ops", "ns/op", "allocs/op", "arena/op",
+            "procs/op");
+
+    for (int i = 0; ARR_SIZES[i] != -1; ++i) {
+        _measure("strarr_add (n words)", ARR_SIZES[i], _op_strarr_add, time);
+    }
+    for (int i = 0; ARR_SIZES[i] != -1; ++i) {
+        bench_arr = strarr_init();
+        for (int j = 0; j < ARR_SIZES[i]; ++j) {
+            strarr_add(&bench_arr, "argument");
+        }
+        _measure("strarr_cp (n words)", ARR_SIZES[i], _op_strarr_cp, time);
+        strarr_del(&bench_arr);
+    }
+
+    for (int i = 0; LINE_SIZES[i] != -1; ++i) {
+        _gen_line(buf, LINE_SIZES[i]);
+        bench_line = buf;
+        _measure("parse (n words)", LINE_SIZES[i], _op_parse, time);
+    }
+
+    /* Syntax is checked by st_build in the same pass in which the tree is built */
+    for (int i = 0; DEPTHS[i] != -1; ++i) {
+        _gen_chain(buf, DEPTHS[i]);
+        _prepare_toks(buf);
+        _measure("st_build && chain", DEPTHS[i], _op_build, time);
+    }
+    for (int i = 0; DEPTHS[i] != -1; ++i) {
+        _gen_brackets(buf, DEPTHS[i]);
+        _prepare_toks(buf);
+        _measure("st_build brackets", DEPTHS[i], _op_build, time);
+    }
+
+    for (int i = 0; STAGES[i] != -1; ++i) {
+        _gen_pipeline(buf, STAGES[i]);
+        _prepare_prog(buf);
+        _measure("shell_run pipeline", STAGES[i], _op_run, time);
+    }
+    for (int i = 0; STAGES[i] != -1; ++i) {
+        _gen_fanout(buf, STAGES[i]);
+        _prepare_prog(buf);
+        _measure("shell_run & fan-out", STAGES[i], _op_run, time);
+    }
+
+    free(buf);
+    jb_delete();
+    vr_delete();
+    ar_delete(&bench_ar);
+    ar_delete(&bench_data_ar);
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include "builtins.h"
+#include "cmdhash.h"
+#include "jobs.h"
+#include "vars.h"
+#include "shelltree.h"
+#include "program.h"
+#include "shellexec.h"
+
+extern const char BASH_NAME[];
+
+/* Builtins */
+int _bi_cd(char **argv, void (*emerg)(void));
+int _bi_pwd(char **argv, void (*emerg)(void));
+int _bi_echo(char **argv, void (*emerg)(void));
+int _bi_true(char **argv, void (*emerg)(void));
+int _bi_false(char **argv, void (*emerg)(void));
+int _bi_exit(char **argv, void (*emerg)(void));
+int _bi_export(char **argv, void (*emerg)(void));
+int _bi_unset(char **argv, void (*emerg)(void));
+int _bi_set(char **argv, void (*emerg)(void));
+int _bi_hash(char **argv, void (*emerg)(void));
+int _bi_jobs(char **argv, void (*emerg)(void));
+int _bi_wait(char **argv, void (*emerg)(void));
+
+/* Registry of builtins */
+const struct
+{
+    const char *name;
+    Builtin fn;
+} BUILTINS[] = {
+    { "cd", _bi_cd },
+    { "pwd", _bi_pwd },
+    { "echo", _bi_echo },
+    { "true", _bi_true },
+    { "false", _bi_false },
+    { "exit", _bi_exit },
+    { "export", _bi_export },
+    { "unset", _bi_unset },
+    { "set", _bi_set },
+    { "hash", _bi_hash },
+    { "jobs", _bi_jobs },
+    { "wait", _bi_wait },
+    { NULL, NULL },
+};
+
+/* The function prints string 'str' processing escape sequences of "echo -e";
+ * returns 0 if output must be stopped (\c) */
+int _echo_esc(const char *str);
+
+Builtin
+bi_find(const char *name)
+{
+    for (int i = 0; BUILTINS[i].name != NULL; ++i) {
+        if (BUILTINS[i].name[0] == name[0] && strcmp(BUILTINS[i].name, name) == 0) {
+            return BUILTINS[i].fn;
+        }
+    }
+    return NULL;
+}
+
+int
+_bi_cd(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    const char *dir = argv[1];
+    if (dir == NULL || strcmp(dir, "~") == 0) {
+        dir = vr_get("HOME", 4);
+        if (dir == NULL) {
+            fprintf(stderr, "%s: cd: HOME not set\n", BASH_NAME);
+            return 1;
+        }
+    }
+    char old[PATH_MAX];
+    const int has_old = getcwd(old, PATH_MAX) != NULL;
+    if (chdir(dir) == -1) {
+        fprintf(stderr, "%s: cd: %s: %s\n", BASH_NAME, dir, strerror(errno));
+        return 1;
+    }
+    /* Variables of the current and of the previous directory follow it */
+    char cur[PATH_MAX];
+    if (has_old) {
+        vr_set("OLDPWD", old, 0);
+    }
+    if (getcwd(cur, PATH_MAX) != NULL) {
+        vr_set("PWD", cur, 0);
+    }
+    return 0;
+}
+
+int
+_bi_pwd(char **argv, void (*emerg)(void))
+{
+    (void)argv;
+    (void)emerg;
+    char dir[PATH_MAX];
+    if (getcwd(dir, PATH_MAX) == NULL) {
+        fprintf(stderr, "%s: pwd: %s\n", BASH_NAME, strerror(errno));
+        return 1;
+    }
+    printf("%s\n", dir);
+    return 0;
+}
+
+int
+_echo_esc(const char *str)
+{
+    while (*str) {
+        if (*str != '\\' || str[1] == '\0') {
+            putchar(*str++);
+            continue;
+        }
+        ++str;
+        switch (*str++) {
+        case 'a': putchar('\a'); break;
+        case 'b': putchar('\b'); break;
+        case 'c': return 0;
+        case 'e': putchar('\033'); break;
+        case 'f': putchar('\f'); break;
+        case 'n': putchar('\n'); break;
+        case 'r': putchar('\r'); break;
+        case 't': putchar('\t'); break;
+        case 'v': putchar('\v'); break;
+        case '\\': putchar('\\'); break;
+        case '0': {
+            /* Octal value (up to 3 digits) */
+            int val = 0;
+            for (int i = 0; i < 3 && *str >= '0' && *str <= '7'; ++i) {
+                val = val * 8 + *str++ - '0';
+            }
+            putchar(val);
+            break;
+        }
+        case 'x':
+            /* Hexadecimal value (up to 2 digits) */
+            if (isxdigit((unsigned char)*str)) {
+                int val = 0;
+                for (int i = 0; i < 2 && isxdigit((unsigned char)*str); ++i, ++str) {
+                    val = val * 16 + (isdigit((unsigned char)*str) ? *str - '0' : tolower(*str) - 'a' + 10);
+                }
+                putchar(val);
+                break;
+            }
+            /* Falls through */
+        default:
+            putchar('\\');
+            putchar(str[-1]);
+        }
+    }
+    return 1;
+}
+
+int
+_bi_echo(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    int newline = 1;
+    int escapes = 0;
+    /* Options: -n (no line feed), -e (escape sequences), -E (no escape sequences) */
+    int i = 1;
+    for (; argv[i] != NULL && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (strspn(argv[i] + 1, "neE") != strlen(argv[i] + 1)) {
+            break;
+        }
+        for (const char *c = argv[i] + 1; *c; ++c) {
+            if (*c == 'n') {
+                newline = 0;
+            } else {
+                escapes = *c == 'e';
+            }
+        }
+    }
+
+    for (int first = i; argv[i] != NULL; ++i) {
+        if (i > first) {
+            putchar(' ');
+        }
+        if (!escapes) {
+            fputs(argv[i], stdout);
+        } else if (!_echo_esc(argv[i])) {
+            return 0;
+        }
+    }
+    if (newline) {
+        putchar('\n');
+    }
+    return 0;
+}
+
+int
+_bi_true(char **argv, void (*emerg)(void))
+{
+    (void)argv;
+    (void)emerg;
+    return 0;
+}
+
+int
+_bi_false(char **argv, void (*emerg)(void))
+{
+    (void)argv;
+    (void)emerg;
+    return 1;
+}
+
+int
+_bi_exit(char **argv, void (*emerg)(void))
+{
+    int status = shell_status();
+    if (argv[1] != NULL) {
+        char *end;
+        status = strtol(argv[1], &end, 10);
+        if (*end != '\0' || end == argv[1]) {
+            fprintf(stderr, "%s: exit: %s: numeric argument required\n", BASH_NAME, argv[1]);
+            status = 2;
+        }
+    }
+    fflush(stdout);
+    emerg();
+    _exit(status & 0xff);
+}
+
+int
+_bi_export(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return vr_export(argv);
+}
+
+int
+_bi_unset(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return vr_unset_builtin(argv);
+}
+
+int
+_bi_set(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return vr_set_builtin(argv);
+}
+
+int
+_bi_hash(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return ch_builtin(argv);
+}
+
+int
+_bi_jobs(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return jb_jobs(argv);
+}
+
+int
+_bi_wait(char **argv, void (*emerg)(void))
+{
+    (void)emerg;
+    return jb_wait(argv);
+}
@@ -0,0 +1,13 @@
+/* The module implements builtin commands, which are executed in the shell process without fork and exec:
+ * cd, pwd, echo, true, false, exit, export, unset, set, hash, jobs, wait */
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+/* Builtin command: executes 'argv' and returns exit status;
+ * 'emerg' is a function that frees memory of the process before it exits */
+typedef int (*Builtin)(char **argv, void (*emerg)(void));
+
+/* Returns builtin command 'name' or NULL if there is no such builtin */
+Builtin bi_find(const char *name);
+
+#endif
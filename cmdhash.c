@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+#include "cmdhash.h"
+#include "vars.h"
+
+enum
+{
+    CAP_MIN = 64, /* Initial capacity of the table (power of 2) */
+};
+
+extern const char BASH_NAME[];
+
+/* Search path which is used if PATH is not set */
+const char PATH_DFLT[] = "/bin:/usr/bin";
+
+/* Entry of the table */
+typedef struct
+{
+    char *name; /* Command name (NULL for empty entry) */
+    char *path; /* Absolute path */
+    unsigned hits; /* Number of lookups */
+} ChEntry;
+
+/* Table with open addressing and linear probing */
+ChEntry *ch_tab = NULL;
+unsigned ch_cap = 0; /* Capacity (power of 2) */
+unsigned ch_count = 0; /* Number of entries */
+char *ch_path = NULL; /* Value of PATH for which the table is filled */
+unsigned ch_path_gen = 0; /* Number of changes of PATH (see vr_path_gen) for which the table is filled */
+
+/* The function returns hash of string */
+unsigned _ch_hash(const char *str);
+
+/* The function returns entry of 'name' or empty entry where it should be inserted */
+ChEntry * _ch_find(const char *name);
+
+/* The function resets the table if PATH has been set or removed since it was filled */
+void _ch_check_path(void);
+
+/* The function searches command 'name' in PATH and returns allocated path or NULL */
+char * _ch_search(const char *name);
+
+unsigned
+_ch_hash(const char *str)
+{
+    /* FNV-1a */
+    register unsigned h = 2166136261u;
+    while (*str) {
+        h = (h ^ (unsigned char)*str++) * 16777619u;
+    }
+    return h;
+}
+
+ChEntry *
+_ch_find(const char *name)
+{
+    register unsigned i = _ch_hash(name) & (ch_cap - 1);
+    while (ch_tab[i].name != NULL && strcmp(ch_tab[i].name, name) != 0) {
+        i = (i + 1) & (ch_cap - 1);
+    }
+    return ch_tab + i;
+}
+
+void
+_ch_check_path(void)
+{
+    /* Only a counter is compared, so a lookup does not depend on length of PATH */
+    if (ch_path != NULL && ch_path_gen == vr_path_gen()) {
+        return;
+    }
+    const char *path = vr_get("PATH", 4);
+    if (path == NULL) {
+        path = PATH_DFLT;
+    }
+    ch_reset();
+    free(ch_path);
+    ch_path = malloc(strlen(path) + 1);
+    strcpy(ch_path, path);
+    ch_path_gen = vr_path_gen();
+}
+
+char *
+_ch_search(const char *name)
+{
+    char cand[PATH_MAX];
+    const int name_len = strlen(name);
+    const char *dir = ch_path;
+    while (1) {
+        const char *end = strchr(dir, ':');
+        const int dir_len = end == NULL ? (int)strlen(dir) : end - dir;
+        /* Empty element of PATH means the current directory */
+        if (dir_len + name_len + 2 <= PATH_MAX) {
+            if (dir_len == 0) {
+                strcpy(cand, name);
+            } else {
+                memcpy(cand, dir, dir_len);
+                cand[dir_len] = '/';
+                strcpy(cand + dir_len + 1, name);
+            }
+            struct stat st;
+            if (stat(cand, &st) == 0 && S_ISREG(st.st_mode) && access(cand, X_OK) == 0) {
+                char *res = malloc(strlen(cand) + 1);
+                strcpy(res, cand);
+                return res;
+            }
+        }
+        if (end == NULL) {
+            return NULL;
+        }
+        dir = end + 1;
+    }
+}
+
+const char *
+ch_lookup(const char *name)
+{
+    if (strchr(name, '/') != NULL) {
+        return name;
+    }
+    _ch_check_path();
+    if (ch_tab != NULL) {
+        ChEntry *ent = _ch_find(name);
+        if (ent->name != NULL) {
+            ++ent->hits;
+            return ent->path;
+        }
+    }
+    char *path = _ch_search(name);
+    if (path == NULL) {
+        return NULL;
+    }
+    ch_add(name, path);
+    free(path);
+    ChEntry *ent = _ch_find(name);
+    ent->hits = 1;
+    return ent->path;
+}
+
+void
+ch_add(const char *name, const char *path)
+{
+    _ch_check_path();
+    /* Keeps load factor not more than 1/2 */
+    if (2 * (ch_count + 1) > ch_cap) {
+        ChEntry *old = ch_tab;
+        const unsigned old_cap = ch_cap;
+        ch_cap = ch_cap == 0 ? CAP_MIN : 2 * ch_cap;
+        ch_tab = calloc(ch_cap, sizeof(*ch_tab));
+        for (unsigned i = 0; i < old_cap; ++i) {
+            if (old[i].name != NULL) {
+                *_ch_find(old[i].name) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    ChEntry *ent = _ch_find(name);
+    if (ent->name == NULL) {
+        ent->name = malloc(strlen(name) + 1);
+        strcpy(ent->name, name);
+        ++ch_count;
+    } else {
+        free(ent->path);
+    }
+    ent->path = malloc(strlen(path) + 1);
+    strcpy(ent->path, path);
+    ent->hits = 0;
+}
+
+void
+ch_forget(const char *name)
+{
+    if (ch_tab == NULL) {
+        return;
+    }
+    ChEntry *ent = _ch_find(name);
+    if (ent->name == NULL) {
+        return;
+    }
+    free(ent->name);
+    free(ent->path);
+    ent->name = NULL;
+    --ch_count;
+
+    /* Moves back the following entries of the cluster, so that lookups do not stop at the hole */
+    register unsigned hole = ent - ch_tab;
+    register unsigned i = (hole + 1) & (ch_cap - 1);
+    while (ch_tab[i].name != NULL) {
+        const unsigned home = _ch_hash(ch_tab[i].name) & (ch_cap - 1);
+        /* The entry can fill the hole if its home is not in (hole, i] cyclically */
+        if (((i - home) & (ch_cap - 1)) >= ((i - hole) & (ch_cap - 1))) {
+            ch_tab[hole] = ch_tab[i];
+            ch_tab[i].name = NULL;
+            hole = i;
+        }
+        i = (i + 1) & (ch_cap - 1);
+    }
+}
+
+void
+ch_reset(void)
+{
+    for (unsigned i = 0; i < ch_cap; ++i) {
+        if (ch_tab[i].name != NULL) {
+            free(ch_tab[i].name);
+            free(ch_tab[i].path);
+            ch_tab[i].name = NULL;
+        }
+    }
+    ch_count = 0;
+}
+
+void
+ch_print(void)
+{
+    if (ch_count == 0) {
+        printf("%s: hash table empty\n", BASH_NAME);
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (unsigned i = 0; i < ch_cap; ++i) {
+        if (ch_tab[i].name != NULL) {
+            printf("%4u\t%s\n", ch_tab[i].hits, ch_tab[i].path);
+        }
+    }
+}
+
+int
+ch_builtin(char **argv)
+{
+    if (argv[1] == NULL) {
+        _ch_check_path();
+        ch_print();
+        return 0;
+    }
+    if (strcmp(argv[1], "-r") == 0) {
+        ch_reset();
+        return 0;
+    }
+    if (strcmp(argv[1], "-p") == 0) {
+        if (argv[2] == NULL || argv[3] == NULL) {
+            fprintf(stderr, "%s: hash: usage: hash [-r] [-p path name] [name ...]\n", BASH_NAME);
+            return 2;
+        }
+        ch_add(argv[3], argv[2]);
+        return 0;
+    }
+
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        if (strchr(argv[i], '/') != NULL) {
+            continue;
+        }
+        /* Searches again even if the command is in the table */
+        ch_forget(argv[i]);
+        if (ch_lookup(argv[i]) == NULL) {
+            fprintf(stderr, "%s: hash: %s: not found\n", BASH_NAME, argv[i]);
+            ret = 1;
+        } else {
+            _ch_find(argv[i])->hits = 0;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,31 @@
+/* The module implements the table of command paths (hash table from command names to absolute paths);
+ * it makes the shell search PATH only once for each command */
+#ifndef CMDHASH_H
+#define CMDHASH_H
+
+/* Returns absolute path of command 'name': takes it from the table or searches it in PATH and remembers;
+ * if 'name' contains '/', returns 'name'; if command is not found, returns NULL;
+ * the table is reset when PATH is set or removed (see vr_path_gen) */
+const char * ch_lookup(const char *name);
+
+/* Adds command 'name' with path 'path' to the table */
+void ch_add(const char *name, const char *path);
+
+/* Removes command 'name' from the table (e.g. if its path is not valid anymore) */
+void ch_forget(const char *name);
+
+/* Removes all commands from the table */
+void ch_reset(void);
+
+/* Prints the table */
+void ch_print(void);
+
+/* Executes builtin "hash":
+ * without arguments prints the table,
+ * "hash -r" resets the table,
+ * "hash -p path name" adds command 'name' with path 'path',
+ * "hash name..." searches commands and adds them;
+ * returns exit status */
+int ch_builtin(char **argv);
+
+#endif
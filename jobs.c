@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "jobs.h"
+#include "timing.h"
+
+enum
+{
+    CAP_MIN = 64, /* Initial capacity of the pid table (power of 2) */
+    LIST_MIN = 16, /* Initial capacity of the list of jobs */
+    SIGINFO_BUF = 16, /* Number of signalfd records read at once */
+    STATUS_SIG = 128, /* Exit status of a process killed by signal is STATUS_SIG + signal number */
+    ERR_NOJOB = 127, /* Exit status of "wait" for unknown job */
+    DONE_KEEP = 256, /* Number of finished jobs which are kept until "jobs" or "wait" if notification is off */
+    FD_SHELL_MIN = 10, /* Minimal descriptor of signalfd; lower ones are left to redirections of commands */
+};
+
+extern const char BASH_NAME[];
+
+typedef struct
+{
+    int id; /* Job number */
+    pid_t *pids; /* Processes of stages (-1 for a stage which was not started) */
+    int count; /* Number of stages */
+    int live; /* Number of processes which are not reaped */
+    int status; /* Exit status of the last stage */
+    struct rusage ru; /* Summary resource usage of reaped processes */
+    double tm_begin; /* Real time of start of timed job ("time ... &") or -1 */
+    char *text; /* Command text */
+    short reported; /* Whether the job is already reported or waited (it is not printed when it finishes) */
+} Job;
+
+/* Entry of the pid table */
+typedef struct
+{
+    pid_t pid; /* Process id (0 for empty entry) */
+    Job *job; /* Job of the process */
+} JbEntry;
+
+/* Jobs ordered by id */
+Job **jb_list = NULL;
+int jb_len = 0;
+int jb_lcap = 0;
+
+/* Table from pids of running processes to their jobs (open addressing and linear probing) */
+JbEntry *jb_tab = NULL;
+unsigned jb_cap = 0; /* Capacity (power of 2) */
+unsigned jb_count = 0; /* Number of entries */
+
+int jb_fd = -1; /* signalfd for SIGCHLD */
+int jb_to_notify = 0;
+sigset_t jb_mask; /* Signal mask of the shell before jb_init */
+
+/* The function returns hash of pid */
+unsigned _jb_hash(pid_t pid);
+
+/* The function returns entry of 'pid' or empty entry where it should be inserted */
+JbEntry * _jb_find(pid_t pid);
+
+/* The function adds process 'pid' of job 'job' to the pid table */
+void _jb_tab_add(pid_t pid, Job *job);
+
+/* The function removes entry from the pid table */
+void _jb_tab_del(JbEntry *ent);
+
+/* The function returns exit status by status of wait */
+int _jb_status(int st);
+
+/* The function prints times of timed job which has finished */
+void _jb_times(Job *job);
+
+/* The function blocks until all processes of job are reaped */
+void _jb_wait_job(Job *job);
+
+/* The function returns job by argument of "jobs" or "wait" ("%id" or pid) or NULL */
+Job * _jb_by_arg(const char *arg);
+
+/* The function prints state of job */
+void _jb_print(Job *job, int to_print_long);
+
+/* The function removes finished jobs from the list except the last 'keep' ones which are not reported;
+ * if 'to_print' is set, prints removed jobs which are not reported */
+void _jb_sweep(int to_print, int keep);
+
+/* The function frees job */
+void _jb_free(Job *job);
+
+unsigned
+_jb_hash(pid_t pid)
+{
+    /* Multiplicative hashing */
+    return (unsigned)pid * 2654435761u;
+}
+
+JbEntry *
+_jb_find(pid_t pid)
+{
+    register unsigned i = _jb_hash(pid) & (jb_cap - 1);
+    while (jb_tab[i].pid != 0 && jb_tab[i].pid != pid) {
+        i = (i + 1) & (jb_cap - 1);
+    }
+    return jb_tab + i;
+}
+
+void
+_jb_tab_add(pid_t pid, Job *job)
+{
+    /* Keeps load factor not more than 1/2 */
+    if (2 * (jb_count + 1) > jb_cap) {
+        JbEntry *old = jb_tab;
+        const unsigned old_cap = jb_cap;
+        jb_cap = jb_cap == 0 ? CAP_MIN : 2 * jb_cap;
+        jb_tab = calloc(jb_cap, sizeof(*jb_tab));
+        for (unsigned i = 0; i < old_cap; ++i) {
+            if (old[i].pid != 0) {
+                *_jb_find(old[i].pid) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    JbEntry *ent = _jb_find(pid);
+    if (ent->pid == 0) {
+        ++jb_count;
+    }
+    ent->pid = pid;
+    ent->job = job;
+}
+
+void
+_jb_tab_del(JbEntry *ent)
+{
+    ent->pid = 0;
+    --jb_count;
+
+    /* Moves back the following entries of the cluster, so that lookups do not stop at the hole */
+    register unsigned hole = ent - jb_tab;
+    register unsigned i = (hole + 1) & (jb_cap - 1);
+    while (jb_tab[i].pid != 0) {
+        const unsigned home = _jb_hash(jb_tab[i].pid) & (jb_cap - 1);
+        /* The entry can fill the hole if its home is not in (hole, i] cyclically */
+        if (((i - home) & (jb_cap - 1)) >= ((i - hole) & (jb_cap - 1))) {
+            jb_tab[hole] = jb_tab[i];
+            jb_tab[i].pid = 0;
+            hole = i;
+        }
+        i = (i + 1) & (jb_cap - 1);
+    }
+}
+
+int
+_jb_status(int st)
+{
+    if (WIFEXITED(st)) {
+        return WEXITSTATUS(st);
+    }
+    if (WIFSIGNALED(st)) {
+        return STATUS_SIG + WTERMSIG(st);
+    }
+    return 1;
+}
+
+int
+jb_exited(pid_t pid, int st, const struct rusage *ru)
+{
+    if (jb_tab == NULL) {
+        return 0;
+    }
+    JbEntry *ent = _jb_find(pid);
+    if (ent->pid == 0) {
+        return 0;
+    }
+    Job *job = ent->job;
+    _jb_tab_del(ent);
+
+    if (pid == job->pids[job->count - 1]) {
+        job->status = _jb_status(st);
+    }
+    if (ru != NULL) {
+        timeradd(&job->ru.ru_utime, &ru->ru_utime, &job->ru.ru_utime);
+        timeradd(&job->ru.ru_stime, &ru->ru_stime, &job->ru.ru_stime);
+    }
+    if (--job->live == 0) {
+        _jb_times(job);
+    }
+    return 1;
+}
+
+void
+_jb_times(Job *job)
+{
+    if (job->tm_begin >= 0) {
+        tm_print(tm_real() - job->tm_begin, tm_sec(&job->ru.ru_utime), tm_sec(&job->ru.ru_stime));
+    }
+}
+
+int
+jb_init(int to_notify)
+{
+    jb_to_notify = to_notify;
+
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &jb_mask);
+    jb_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (jb_fd != -1 && jb_fd < FD_SHELL_MIN) {
+        const int fd = fcntl(jb_fd, F_DUPFD_CLOEXEC, FD_SHELL_MIN);
+        close(jb_fd);
+        jb_fd = fd;
+    }
+    return jb_fd;
+}
+
+const sigset_t *
+jb_sigmask(void)
+{
+    return &jb_mask;
+}
+
+int
+jb_add(const pid_t *pids, int count, int status, const char *text, double tm_begin)
+{
+    Job *job = calloc(1, sizeof(*job));
+    job->id = jb_len == 0 ? 1 : jb_list[jb_len - 1]->id + 1;
+    job->count = count;
+    job->pids = malloc(count * sizeof(*job->pids));
+    memcpy(job->pids, pids, count * sizeof(*job->pids));
+    job->status = status;
+    job->tm_begin = tm_begin;
+    job->text = malloc(strlen(text) + 1);
+    strcpy(job->text, text);
+    for (int i = 0; i < count; ++i) {
+        if (pids[i] != -1) {
+            _jb_tab_add(pids[i], job);
+            ++job->live;
+        }
+    }
+
+    if (jb_len == jb_lcap) {
+        jb_lcap = jb_lcap == 0 ? LIST_MIN : 2 * jb_lcap;
+        jb_list = realloc(jb_list, jb_lcap * sizeof(*jb_list));
+    }
+    jb_list[jb_len++] = job;
+    if (job->live == 0) {
+        _jb_times(job);
+    }
+
+    if (jb_to_notify) {
+        printf("[%d] %d\n", job->id, pids[count - 1]);
+        fflush(stdout);
+    }
+    return job->id;
+}
+
+void
+jb_reap(void)
+{
+    /* Drains pending notifications: one signal may stand for several exited sons */
+    if (jb_fd != -1) {
+        struct signalfd_siginfo si[SIGINFO_BUF];
+        while (read(jb_fd, si, sizeof(si)) > 0) {
+        }
+    }
+
+    pid_t pid;
+    int st;
+    struct rusage ru;
+    while ((pid = wait4(-1, &st, WNOHANG, &ru)) > 0) {
+        jb_exited(pid, st, &ru);
+    }
+}
+
+void
+_jb_wait_job(Job *job)
+{
+    for (int i = 0; i < job->count && job->live > 0; ++i) {
+        if (job->pids[i] == -1 || _jb_find(job->pids[i])->pid == 0) {
+            continue;
+        }
+        int st = 0;
+        struct rusage ru;
+        pid_t pid;
+        while ((pid = wait4(job->pids[i], &st, 0, &ru)) == -1 && errno == EINTR) {
+        }
+        /* The process may be not a son (e.g. "wait" is executed in a son of the shell) */
+        jb_exited(job->pids[i], st, pid == -1 ? NULL : &ru);
+    }
+}
+
+Job *
+_jb_by_arg(const char *arg)
+{
+    char *end;
+    const int is_id = arg[0] == '%';
+    const long num = strtol(arg + is_id, &end, 10);
+    if (*end != '\0' || end == arg + is_id) {
+        return NULL;
+    }
+    if (!is_id && jb_tab != NULL) {
+        /* Running process is found in the table at once */
+        JbEntry *ent = _jb_find(num);
+        if (ent->pid != 0) {
+            return ent->job;
+        }
+    }
+    for (int i = 0; i < jb_len; ++i) {
+        if (is_id && jb_list[i]->id == num) {
+            return jb_list[i];
+        }
+        for (int j = 0; !is_id && j < jb_list[i]->count; ++j) {
+            if (jb_list[i]->pids[j] == num) {
+                return jb_list[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+void
+_jb_print(Job *job, int to_print_long)
+{
+    char state[32];
+    if (job->live > 0) {
+        strcpy(state, "Running");
+    } else if (job->status == 0) {
+        strcpy(state, "Done");
+    } else {
+        sprintf(state, "Exit %d", job->status);
+    }
+
+    printf("[%d]  ", job->id);
+    if (to_print_long) {
+        printf("%d ", job->pids[job->count - 1]);
+    }
+    printf("%-24s", state);
+    if (to_print_long && job->live == 0) {
+        printf("user %ld.%03lds sys %ld.%03lds  ",
+                (long)job->ru.ru_utime.tv_sec, (long)job->ru.ru_utime.tv_usec / 1000,
+                (long)job->ru.ru_stime.tv_sec, (long)job->ru.ru_stime.tv_usec / 1000);
+    }
+    printf("%s\n", job->text);
+}
+
+void
+_jb_free(Job *job)
+{
+    /* Processes which are not reaped are forgotten */
+    for (int i = 0; i < job->count; ++i) {
+        if (job->pids[i] != -1 && jb_tab != NULL) {
+            JbEntry *ent = _jb_find(job->pids[i]);
+            if (ent->pid != 0 && ent->job == job) {
+                _jb_tab_del(ent);
+            }
+        }
+    }
+    free(job->pids);
+    free(job->text);
+    free(job);
+}
+
+void
+_jb_sweep(int to_print, int keep)
+{
+    /* Finds the first job which is kept though it is finished */
+    int kept_from = jb_len;
+    for (int i = jb_len - 1; i >= 0 && keep > 0; --i) {
+        if (jb_list[i]->live == 0 && !jb_list[i]->reported) {
+            kept_from = i;
+            --keep;
+        }
+    }
+
+    int n = 0;
+    for (int i = 0; i < jb_len; ++i) {
+        if (jb_list[i]->live > 0 || (i >= kept_from && !jb_list[i]->reported)) {
+            jb_list[n++] = jb_list[i];
+            continue;
+        }
+        if (to_print && !jb_list[i]->reported) {
+            _jb_print(jb_list[i], 0);
+        }
+        _jb_free(jb_list[i]);
+    }
+    jb_len = n;
+}
+
+void
+jb_notify(void)
+{
+    _jb_sweep(jb_to_notify, jb_to_notify ? 0 : DONE_KEEP);
+    fflush(stdout);
+}
+
+int
+jb_jobs(char **argv)
+{
+    int to_print_long = 0;
+    if (argv[1] != NULL) {
+        if (strcmp(argv[1], "-l") != 0) {
+            fprintf(stderr, "%s: jobs: usage: jobs [-l]\n", BASH_NAME);
+            return 2;
+        }
+        to_print_long = 1;
+    }
+
+    jb_reap();
+    for (int i = 0; i < jb_len; ++i) {
+        _jb_print(jb_list[i], to_print_long);
+        /* Finished jobs are reported only once */
+        jb_list[i]->reported = jb_list[i]->live == 0;
+    }
+    return 0;
+}
+
+int
+jb_wait(char **argv)
+{
+    if (argv[1] == NULL) {
+        for (int i = 0; i < jb_len; ++i) {
+            _jb_wait_job(jb_list[i]);
+            jb_list[i]->reported = 1;
+        }
+        return 0;
+    }
+
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        Job *job = _jb_by_arg(argv[i]);
+        if (job == NULL) {
+            fprintf(stderr, "%s: wait: %s: no such job\n", BASH_NAME, argv[i]);
+            ret = ERR_NOJOB;
+            continue;
+        }
+        _jb_wait_job(job);
+        job->reported = 1;
+        ret = job->status;
+    }
+    return ret;
+}
+
+void
+jb_delete(void)
+{
+    for (int i = 0; i < jb_len; ++i) {
+        _jb_free(jb_list[i]);
+    }
+    free(jb_list);
+    free(jb_tab);
+    jb_list = NULL;
+    jb_tab = NULL;
+    jb_len = jb_lcap = 0;
+    jb_cap = jb_count = 0;
+    if (jb_fd != -1) {
+        close(jb_fd);
+        jb_fd = -1;
+    }
+}
@@ -0,0 +1,47 @@
+/* The module implements the table of background jobs;
+ * exits of their processes are received through signalfd, so that they are reaped as soon as the shell is idle;
+ * while a foreground pipeline is waited, its waiting loop reaps them (see jb_exited) */
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/* Blocks SIGCHLD and returns signalfd descriptor which becomes readable when a son exits;
+ * if 'to_notify' is set, the shell prints ids of started jobs and finished jobs (see jb_notify) */
+int jb_init(int to_notify);
+
+/* Returns signal mask which sons must have after exec (the mask of the shell before jb_init) */
+const sigset_t * jb_sigmask(void);
+
+/* Adds job of processes 'pids' (stages of pipeline; -1 for a stage which was not started)
+ * with command text 'text'; 'status' is exit status of the job if its last stage was not started;
+ * if 'tm_begin' is not negative, the job is timed since that real time (see tm_real)
+ * and its real, user and system time are printed when it finishes; returns id of the job */
+int jb_add(const pid_t *pids, int count, int status, const char *text, double tm_begin);
+
+/* Reaps all exited processes of jobs without blocking */
+void jb_reap(void);
+
+/* Records exit of process 'pid' with status 'st' and resource usage 'ru' (may be NULL) which is reaped
+ * by the caller; returns 1 if it is a process of a job, otherwise 0 */
+int jb_exited(pid_t pid, int st, const struct rusage *ru);
+
+/* Prints finished jobs and removes them from the table;
+ * if notification is off, finished jobs are kept (a limited number of them) until "jobs" or "wait" reports them */
+void jb_notify(void);
+
+/* Executes builtin "jobs": prints all jobs ("jobs -l" also prints pids and CPU time of finished jobs);
+ * returns exit status */
+int jb_jobs(char **argv);
+
+/* Executes builtin "wait":
+ * "wait" waits all jobs,
+ * "wait %id..." or "wait pid..." waits given jobs and returns exit status of the last one */
+int jb_wait(char **argv);
+
+/* Frees the table and closes signalfd */
+void jb_delete(void);
+
+#endif
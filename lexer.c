@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include "arena.h"
+#include "lexer.h"
+#include "vars.h"
+
+enum
+{
+    BUF_SIZE = 32, /* for values of numeric variables */
+    TOKS_MIN = 16, /* Initial capacity of token array */
+    FD_DIGITS_MAX = 4, /* Maximal number of digits of descriptor before redirection */
+};
+
+/* Key characters */
+const char QUOT[] = "\'\"";
+const char SPACES[] = " \t\n";
+const char OPERS[] = "();<>&|";
+const char VAR = '$';
+const char VAR_OPEN = '{';
+const char VAR_CLOSE = '}';
+const char VAR_STATUS = '?';
+const char SLASH = '\\';
+const char COMMENT = '#';
+const char TIME_WORD[] = "time";
+const char TEMPLATE_CHARS[] = "$\\"; /* Characters which are only in templates of words */
+
+/* Spellings of operators (indexed by token kind) */
+const char * const TK_STR[] = { NULL, "(", ")", "<", ">", ">>", "|", "||", "&&", "&", ";",
+        ">&", "<&", "<>", "<<<" };
+const int TK_STR_COUNT = sizeof(TK_STR) / sizeof(*TK_STR);
+
+
+/* Values of special variables: $? and $EUID (EUID is computed once) */
+char lex_status_val[BUF_SIZE] = "0";
+char lex_euid_val[BUF_SIZE] = "";
+
+/* Growable array of tokens */
+typedef struct
+{
+    Token *toks; /* Tokens */
+    int count; /* Number of tokens */
+    int cap; /* Capacity */
+    Arena *ar; /* Arena where tokens are allocated */
+} TokBuf;
+
+/* The function adds token to array */
+void _tok_add(TokBuf *tb, char *str, int len, short kind);
+
+/* The function returns kind of the longest operator which starts at 'str' and writes its length to '*plen' */
+short _op_kind(const char *str, int *plen);
+
+/* The function returns 1 if operator 'kind' is a redirection (it may be preceded by a descriptor number) */
+int _is_redir(short kind);
+
+/* The function returns descriptor number written in word ['begin', 'end') of 'line' or -1 if it is not a number */
+int _fd_number(const char *line, int begin, int end);
+
+/* The function returns a copy of 'str' of length 'len' with replaced escape sequences
+ * as a template of word for lex_expand: variables are written as ${NAME}, and characters $ and \ as \$ and \\;
+ * if 'seq' is NULL, then processes escape sequence with any character;
+ * otherwise processes only characters from 'seq';
+ * length of result is written to '*plen' */
+char * _rewrite(const char *str, int len, const char *seq, int *plen, Arena *ar);
+
+/* The function adds word ['begin', 'end') of 'line' to array;
+ * if 'dirty' is 0, the word is terminated in place, otherwise it is rewritten (see _rewrite);
+ * unquoted (with NULL 'seq') word "time" after an operator which starts a list is added as TK_TIME */
+void _add_word(TokBuf *tb, char *line, int begin, int end, int dirty, const char *seq);
+
+void
+_tok_add(TokBuf *tb, char *str, int len, short kind)
+{
+    if (tb->count == tb->cap) {
+        tb->toks = ar_realloc(tb->ar, tb->toks, tb->cap * sizeof(Token), 2 * tb->cap * sizeof(Token));
+        tb->cap *= 2;
+    }
+    Token *tok = tb->toks + tb->count++;
+    tok->str = str;
+    tok->len = len;
+    tok->kind = kind;
+    tok->fd = -1;
+}
+
+short
+_op_kind(const char *str, int *plen)
+{
+    short kind = TK_SEMI;
+    *plen = 0;
+    for (short k = TK_LPAREN; k < TK_STR_COUNT; ++k) {
+        const int len = strlen(TK_STR[k]);
+        if (len > *plen && strncmp(str, TK_STR[k], len) == 0) {
+            kind = k;
+            *plen = len;
+        }
+    }
+    return kind;
+}
+
+int
+_is_redir(short kind)
+{
+    return kind == TK_LT || kind == TK_GT || kind == TK_GTGT || kind >= TK_DUPOUT;
+}
+
+int
+_fd_number(const char *line, int begin, int end)
+{
+    if (begin == end || end - begin > FD_DIGITS_MAX) {
+        return -1;
+    }
+    int fd = 0;
+    for (int i = begin; i < end; ++i) {
+        if (!isdigit((unsigned char)line[i])) {
+            return -1;
+        }
+        fd = 10 * fd + line[i] - '0';
+    }
+    return fd;
+}
+
+int
+lex_ref(const char *str, int len, const char **pname, int *pname_len)
+{
+    if (len > 0 && str[0] == VAR_STATUS) {
+        *pname = str;
+        *pname_len = 1;
+        return 1;
+    }
+    const int braced = len > 0 && str[0] == VAR_OPEN;
+    register int j = braced;
+    while (j < len && (isalnum((unsigned char)str[j]) || str[j] == '_' || (braced && j == 1 && str[j] == VAR_STATUS))) {
+        ++j;
+    }
+    *pname = str + braced;
+    *pname_len = j - braced;
+    if (*pname_len == 0) {
+        return 0;
+    }
+    if (braced) {
+        /* Without closing bracket, ${ is not a reference */
+        return j < len && str[j] == VAR_CLOSE ? j + 1 : 0;
+    }
+    return j;
+}
+
+const char *
+lex_var(const char *name, int len)
+{
+    if (len == 1 && name[0] == VAR_STATUS) {
+        return lex_status_val;
+    }
+    if (len == 4 && strncmp(name, "EUID", 4) == 0) {
+        if (lex_euid_val[0] == '\0') {
+            sprintf(lex_euid_val, "%d", geteuid());
+        }
+        return lex_euid_val;
+    }
+    return vr_get(name, len);
+}
+
+void
+lex_set_status(int status)
+{
+    sprintf(lex_status_val, "%d", status);
+}
+
+char *
+_rewrite(const char *str, int len, const char *seq, int *plen, Arena *ar)
+{
+    /* The result is the last allocation in arena, so it usually grows in place */
+    int cap = len + 1;
+    char *res = ar_alloc(ar, cap);
+    register int n = 0; /* Length of result */
+    register int i = 0; /* Position in 'str' */
+    while (i < len) {
+        const char *frag = str + i; /* Character or name of variable to append */
+        int frag_len = 1;
+        int is_ref = 0;
+        if (str[i] == SLASH && i + 1 < len && (seq == NULL || strchr(seq, str[i + 1]) != NULL)) {
+            /* Escape sequence is replaced by the character */
+            frag = str + i + 1;
+            i += 2;
+        } else if (str[i] == VAR) {
+            /* Variable ($NAME, ${NAME} or $?) is written as ${NAME}, so that following characters
+             * do not extend its name; $ without a name is a character */
+            const int ref_len = lex_ref(str + i + 1, len - i - 1, &frag, &frag_len);
+            is_ref = ref_len > 0;
+            if (!is_ref) {
+                frag = str + i;
+                frag_len = 1;
+            }
+            i += 1 + ref_len;
+        } else {
+            ++i;
+        }
+        /* Characters $ and \ are escaped in the template */
+        const int escape = !is_ref && (*frag == SLASH || *frag == VAR);
+        const int need = is_ref ? frag_len + 3 : 1 + escape;
+        if (n + need + 1 > cap) {
+            const int new_cap = 2 * cap > n + need + 1 ? 2 * cap : n + need + 1;
+            res = ar_realloc(ar, res, cap, new_cap);
+            cap = new_cap;
+        }
+        if (is_ref) {
+            res[n++] = VAR;
+            res[n++] = VAR_OPEN;
+            memcpy(res + n, frag, frag_len);
+            n += frag_len;
+            res[n++] = VAR_CLOSE;
+        } else {
+            if (escape) {
+                res[n++] = SLASH;
+            }
+            res[n++] = *frag;
+        }
+    }
+    res[n] = '\0';
+    *plen = n;
+    return res;
+}
+
+int
+lex_to_expand(const char *word)
+{
+    return strpbrk(word, TEMPLATE_CHARS) != NULL;
+}
+
+char *
+lex_expand(char *word, Arena *ar)
+{
+    if (!lex_to_expand(word)) {
+        return word;
+    }
+    const int len = strlen(word);
+    int cap = len + 1;
+    char *res = ar_alloc(ar, cap);
+    register int n = 0; /* Length of result */
+    register int i = 0; /* Position in 'word' */
+    while (i < len) {
+        const char *frag = word + i; /* Fragment to append */
+        int frag_len = 1;
+        if (word[i] == SLASH && i + 1 < len) {
+            frag = word + i + 1;
+            i += 2;
+        } else if (word[i] == VAR) {
+            /* Unset variable is removed */
+            const char *name;
+            int name_len;
+            i += 1 + lex_ref(word + i + 1, len - i - 1, &name, &name_len);
+            frag = lex_var(name, name_len);
+            frag_len = frag == NULL ? 0 : strlen(frag);
+        } else {
+            ++i;
+        }
+        if (n + frag_len + 1 > cap) {
+            const int new_cap = 2 * cap > n + frag_len + 1 ? 2 * cap : n + frag_len + 1;
+            res = ar_realloc(ar, res, cap, new_cap);
+            cap = new_cap;
+        }
+        memcpy(res + n, frag, frag_len);
+        n += frag_len;
+    }
+    res[n] = '\0';
+    return res;
+}
+
+void
+_add_word(TokBuf *tb, char *line, int begin, int end, int dirty, const char *seq)
+{
+    if (dirty) {
+        int len;
+        char *str = _rewrite(line + begin, end - begin, seq, &len, tb->ar);
+        _tok_add(tb, str, len, TK_WORD);
+    } else {
+        /* The character after the word is already processed, so it can be overwritten */
+        line[end] = '\0';
+        short kind = TK_WORD;
+        if (seq == NULL && strcmp(line + begin, TIME_WORD) == 0) {
+            const short prev = tb->count == 0 ? TK_SEMI : tb->toks[tb->count - 1].kind;
+            if (prev == TK_SEMI || prev == TK_AMP || prev == TK_ANDAND || prev == TK_OROR || prev == TK_LPAREN) {
+                kind = TK_TIME;
+            }
+        }
+        _tok_add(tb, line + begin, end - begin, kind);
+    }
+}
+
+int
+lex(char *line, Token **ptoks, Arena *ar)
+{
+    TokBuf tb = { ar_alloc(ar, TOKS_MIN * sizeof(Token)), 0, TOKS_MIN, ar };
+
+    char quot = 0; /* Flag of quot marks: possible values: \0 or \" or \' */
+    int dirty = 0; /* Whether the current word has escape sequences or variables */
+    register int begin = 0; /* Beginning of the current word */
+    register int i = 0; /* Current position */
+    char c;
+    /* Iterates by characters */
+    while ((c = line[i]) != '\0') {
+        if (quot) { /* If inside quots */
+            if (c == quot) {
+                /* Adds the current word to array (even if it is empty) */
+                const char seq[] = { SLASH, VAR, quot, 0 };
+                _add_word(&tb, line, begin, i, dirty, seq);
+                quot = 0;
+                /* Moves to the next word */
+                begin = ++i;
+                dirty = 0;
+            } else if (c == SLASH) {
+                /* Moves to the next-next character */
+                dirty = 1;
+                i += line[i + 1] != '\0' ? 2 : 1;
+            } else {
+                dirty |= c == VAR;
+                ++i;
+            }
+        } else { /* If outside quots */
+            int op_len = 0; /* Length of operator at the current position */
+            short kind = TK_SEMI;
+            if (strchr(OPERS, c) != NULL) {
+                kind = _op_kind(line + i, &op_len);
+            }
+
+            if (op_len) {
+                /* Adds the previous word and the operator to array;
+                 * digits just before a redirection are its descriptor (2>file), not a word */
+                const int fd = _is_redir(kind) && !dirty ? _fd_number(line, begin, i) : -1;
+                if (begin < i && fd == -1) _add_word(&tb, line, begin, i, dirty, NULL);
+                _tok_add(&tb, (char *)TK_STR[kind], op_len, kind);
+                tb.toks[tb.count - 1].fd = fd;
+                /* Moves to the next word */
+                i += op_len;
+                begin = i;
+                dirty = 0;
+            } else if (strchr(QUOT, c) != NULL || strchr(SPACES, c) != NULL) {
+                /* Adds the previous word to array */
+                if (begin < i) _add_word(&tb, line, begin, i, dirty, NULL);
+                /* Sets quot flag */
+                if (strchr(QUOT, c) != NULL) {
+                    quot = c;
+                }
+                /* Moves to the next word */
+                begin = ++i;
+                dirty = 0;
+            } else if (c == SLASH) {
+                /* Moves to the next-next character */
+                dirty = 1;
+                i += line[i + 1] != '\0' ? 2 : 1;
+            } else if (c == COMMENT) {
+                /* Stops reading */
+                break;
+            } else {
+                dirty |= c == VAR;
+                ++i;
+            }
+        }
+    }
+
+    if (quot) {
+        return -1;
+    }
+    /* If there is one more word, then adds it to array */
+    if (begin < i) {
+        _add_word(&tb, line, begin, i, dirty, NULL);
+    }
+
+    *ptoks = tb.toks;
+    return tb.count;
+}
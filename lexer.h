@@ -0,0 +1,68 @@
+/* The module implements the lexer of shell input:
+ * it splits one contiguous line into tokens which refer to the line itself */
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "arena.h"
+
+enum TOKENS /* Values of Token.kind */
+{
+    TK_WORD = 0, /* Word (command, argument or file name) */
+    TK_LPAREN = 1, /* ( */
+    TK_RPAREN = 2, /* ) */
+    TK_LT = 3, /* < */
+    TK_GT = 4, /* > */
+    TK_GTGT = 5, /* >> */
+    TK_PIPE = 6, /* | */
+    TK_OROR = 7, /* || */
+    TK_ANDAND = 8, /* && */
+    TK_AMP = 9, /* & */
+    TK_SEMI = 10, /* ; */
+    TK_DUPOUT = 11, /* >& */
+    TK_DUPIN = 12, /* <& */
+    TK_RDWR = 13, /* <> */
+    TK_HERESTR = 14, /* <<< */
+    TK_TIME = 15, /* Reserved word "time" before a pipeline */
+};
+
+typedef struct token Token;
+struct token
+{
+    char *str; /* Text of token (NUL-terminated) */
+    int len; /* Length of text */
+    short kind; /* Kind of token */
+    int fd; /* Descriptor number written just before a redirection operator (2 in 2>file) or -1 */
+};
+
+/* The function splits NUL-terminated string 'line' into tokens, writes array of them to '*ptoks'
+ * and returns their number; if quotes are not closed, returns -1;
+ * unquoted word "time" at the beginning of a command list is reserved word TK_TIME;
+ * variables are not expanded here: a word with variables is a template for lex_expand,
+ * which is expanded right before its command is executed;
+ * words without escape sequences and variables are not copied: they point into 'line',
+ * which is modified to terminate them; other words and the array are allocated in arena 'ar';
+ * operators point to static strings */
+int lex(char *line, Token **ptoks, Arena *ar);
+
+/* Returns 1 if word 'word' made by lex is a template which should be expanded by lex_expand
+ * (it has variables or escaped characters $ and \) */
+int lex_to_expand(const char *word);
+
+/* Returns word 'word' made by lex with values of its variables and without escaping;
+ * a word which is not a template is returned itself, otherwise the result is allocated in arena 'ar' */
+char * lex_expand(char *word, Arena *ar);
+
+/* Returns length of variable reference ($NAME, ${NAME} or $?) which starts at 'str' after $
+ * ('str' has 'len' characters) and writes its name and length of name to '*pname' and '*pname_len';
+ * if there is no reference (e.g. $ is followed by a space), returns 0 */
+int lex_ref(const char *str, int len, const char **pname, int *pname_len);
+
+/* Returns value of variable 'name' of length 'len' or NULL if it is not set;
+ * ? is exit status set by lex_set_status, EUID is effective user id (it is computed once),
+ * other variables are taken from the table of shell variables */
+const char * lex_var(const char *name, int len);
+
+/* Sets exit status which is the value of $? */
+void lex_set_status(int status);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> /* for pplr */
+#include <errno.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
@@ -8,22 +9,48 @@
 #include <fcntl.h>
 #include <linux/limits.h>
 #include "colors.h"
+#include "arena.h"
+#include "reader.h"
 #include "strarr.h"
+#include "lexer.h"
 #include "shelltree.h"
+#include "program.h"
 #include "shellexec.h"
+#include "jobs.h"
 #include "parse.h"
+#include "pcache.h"
+#include "vars.h"
+#include "timing.h"
+#include "alloc.h"
 
 enum
 {
-    BUF_SIZE = 4, /* Size of input buffer */
-    TESTBUF_SIZE = 4096, /* Size of buffer for test input */
-    ARGC = 2, /* Expected number of console arguments */
+    TESTBUF_SIZE = 4096, /* Size of buffer for test file name */
     FLAGS_DFLT = 16, /* Default flags value (if flags value is not specified) */
+    FLAGS_MAX = 1023, /* All flags (see main) */
+    ERR_FLAGS = 2, /* Exit status if flags value is out of range */
+    ERR_SCRIPT = 127, /* Exit status if script can not be opened */
+    SITES_MAX = 10, /* Maximal number of printed call sites of allocations */
+    FD_SHELL_MIN = 10, /* Minimal descriptor of input file; lower ones are left to redirections of commands */
 };
 
+enum PHASES /* Phases of processing of one line (for flag 256) */
+{
+    PH_READ = 0,
+    PH_PARSE = 1,
+    PH_BUILD = 2,
+    PH_COMPILE = 3,
+    PH_EXEC = 4,
+    PH_COUNT = 5,
+};
+
+const char * const PH_NAMES[] = { "read", "parse", "build", "compile", "exec" };
+
 const char *FRMT_ARR = "[\033[033m%s\033[0m]"; /* Format for array print */
 const char BASH_NAME[] = "anbash";
 
+extern char **environ;
+
 /* Signal handler */
 void sig_handler(int s);
 
@@ -36,6 +63,15 @@ void free_mem(void);
 /* What to do if execution in son is failed after fork */
 void emerg_shutdown(void);
 
+/* Adds time and allocations since the previous mark to phase 'ph' (if 'ph' is -1, only sets the mark) */
+void phase_mark(int ph);
+
+/* Prints times of phases of the line and resets them */
+void phase_print(void);
+
+/* Prints allocations of phases of the line and their call sites and resets them */
+void phase_print_allocs(void);
+
 /* Forms strarr 'words' of lexemas of a tree and array 'counters' of their occurrences */
 void pplr_rate(ShTree *tree, int *counters, strarr *words);
 
@@ -44,13 +80,25 @@ void pplr_rate(ShTree *tree, int *counters, strarr *words);
 char * find_most_pplr(ShTree *tree, int *count);
 
 /* Global variables */
-strarr inp_arr = NULL;
-strarr st_argv = NULL;
-ShTree *st = NULL;
+Arena *line_ar = NULL; /* Arena for input, tokens and tree of one line; it is reset after each line */
+Reader *inp = NULL; /* Reader of input (stdin, testfile or script) */
 char *test_fn = NULL;
-FILE *testfile = NULL;
+int inpfd = -1; /* Descriptor of testfile or script */
 char curdir[PATH_MAX];
-int bg_pp[2];
+
+/* Times of phases of the current line (flag 256): wall clock and CPU time of the shell in seconds */
+short to_time_phases = 0;
+double ph_real[PH_COUNT];
+double ph_cpu[PH_COUNT];
+double ph_children = 0; /* CPU time of sons waited during execution */
+double mark_real = 0;
+double mark_cpu = 0;
+
+/* Allocations of phases of the current line (flag 512) */
+short to_count_allocs = 0;
+AlTotals ph_allocs[PH_COUNT];
+size_t ph_peak[PH_COUNT]; /* Peak of live heap bytes of each phase */
+AlTotals mark_allocs;
 
 int
 main(int argc, char **argv)
@@ -58,6 +106,9 @@ main(int argc, char **argv)
     /* Sets signal handler for SIGINT */
     sigaction(SIGINT, &(struct sigaction){.sa_handler = sig_handler, .sa_flags = SA_RESTART}, NULL);
 
+    /* Console arguments: [flags] [script] */
+    int argi = 1;
+
     /* Sets processing flags:
      * flags & 1  - to print input
      * flags & 2  - to print parsed input
@@ -65,98 +116,139 @@ main(int argc, char **argv)
      * flags & 8  - to print all fields in bash tree
      * flags & 16 - to execute commands
      * flags & 32 - to test program
+     * flags & 64 - to print statistics of parse cache at the end of input
+     * flags & 128 - to print compiled program
+     * flags & 256 - to print wall and CPU time of each phase of a line
+     * flags & 512 - to print allocations of each phase of a line and their call sites
      * */
-    const short flags = argc < ARGC ? FLAGS_DFLT : atoi(argv[1]); /* If flags are not specified, sets default */
+    short flags = FLAGS_DFLT; /* If flags are not specified, sets default */
+    if (argi < argc) {
+        /* Only a wholly numeric argument is flags, so scripts like 2024-run.sh are not taken for them */
+        char *end;
+        const long val = strtol(argv[argi], &end, 10);
+        if (end != argv[argi] && *end == '\0') {
+            if (val < 0 || val > FLAGS_MAX) {
+                fprintf(stderr, "%s: %s: flags must be from 0 to %d\n", BASH_NAME, argv[argi], FLAGS_MAX);
+                exit(ERR_FLAGS);
+            }
+            flags = val;
+            ++argi;
+        }
+    }
     const short to_print_input = flags & 1;
     const short to_print_pars = flags & 2;
     const short to_print_tree = flags & 4;
     const short to_print_full = flags & 8;
     const short to_exec = flags & 16;
     const short to_test = flags & 32;
+    const short to_print_stats = flags & 64;
+    const short to_print_prog = flags & 128;
+    to_time_phases = flags & 256;
+    to_count_allocs = flags & 512;
+    al_enable(to_count_allocs);
 
     /* If test mode is enabled, scans filename and opens testfile */
     if (to_test) {
         test_fn = calloc(TESTBUF_SIZE, sizeof(*test_fn));
-        while (testfile == NULL) {
+        while (inpfd == -1) {
             scanf("%s", test_fn);
-            testfile = fopen(test_fn, "r");
+            inpfd = open(test_fn, O_RDONLY | O_CLOEXEC);
         }
+    } else if (argi < argc) {
+        /* If script is specified, opens it */
+        inpfd = open(argv[argi], O_RDONLY | O_CLOEXEC);
+        if (inpfd == -1) {
+            fprintf(stderr, "%s: %s: %s\n", BASH_NAME, argv[argi], strerror(errno));
+            exit(ERR_SCRIPT);
+        }
+    }
+    if (inpfd != -1 && inpfd < FD_SHELL_MIN) {
+        const int fd = fcntl(inpfd, F_DUPFD_CLOEXEC, FD_SHELL_MIN);
+        close(inpfd);
+        inpfd = fd;
     }
 
-    pipe(bg_pp);
-    fcntl(bg_pp[0], F_SETFL, O_NONBLOCK, 1);
-    fcntl(bg_pp[1], F_SETFL, O_NONBLOCK, 1);
+    /* Batch mode: commands are read from script or from non-terminal stdin;
+     * there is no prompt, and each statement is executed right after it is parsed */
+    const short to_batch = !to_test && (inpfd != -1 || !isatty(0));
+
+    inp = rd_init(inpfd != -1 ? inpfd : 0);
+    line_ar = ar_init();
+    vr_init(environ);
+
+    /* Exited background processes are reaped while the shell waits for input and before each line;
+     * finished jobs are reported only in interactive mode */
+    rd_watch(inp, jb_init(!to_batch && !to_test), jb_reap);
+    al_reset();
 
-    char buf[BUF_SIZE + 1] = { 0 };
     while (1) {
-        /* Removes zombies */
-        pid_t pid;
-        while (read(bg_pp[0], &pid, sizeof(pid)) == sizeof(pid)) {
-            kill(pid, SIGKILL);
-            waitpid(pid, NULL, 1);
-        }
-        
+        jb_reap();
+        jb_notify();
+
         /* Prompt to enter */
-        prompt();
-        inp_arr = strarr_init();
-
-        if (to_test) { /* If test mode is enabled */
-            /* Scans line from testfile */
-            char buf[TESTBUF_SIZE];
-            if (fgets(buf, TESTBUF_SIZE, testfile) == NULL) {
-                /* If finds EOF, stops processing */
-                free_mem();
-                write(1, "\n", 1);
-                _exit(0);
-            }
-            int size = strlen(buf);
-            if (size > 1) {
-                buf[size - 1] = '\0';
-            }
-            /* Prints current test input */
-            printf("%s\n", buf);
-            /* Adds string to array */
-            strarr_add(&inp_arr, buf);
-        } else { /* If test mode is disabled */
-            /* Scans line in buffer by parts */
-            int size = 0;
-            while ((size = read(0, buf, BUF_SIZE)) == BUF_SIZE && buf[BUF_SIZE - 1] != '\n') {
-                strarr_add(&inp_arr, buf);
-            }
-            /* Ctrl+D processing */
-            if (size == 0) {
-                free_mem();
+        if (!to_batch) {
+            prompt();
+        }
+        /* Scans line (it is contiguous and has no length limit; a very long line comes in parts by commands) */
+        phase_mark(-1);
+        char *line = rd_cmd(inp, NULL);
+        phase_mark(PH_READ);
+        if (line == NULL) {
+            /* If finds EOF (or Ctrl+D), stops processing */
+            if (!to_batch) {
                 write(1, "\n", 1);
-                _exit(0);
             }
-            /* Adds string to array */
-            if (size > 1) {
-                buf[size - 1] = '\0';
-                strarr_add(&inp_arr, buf);
+            if (to_print_stats) {
+                pc_print_stats();
             }
+            free_mem();
+            fflush(stdout);
+            _exit(0);
+        }
+        /* Prints current test input */
+        if (to_test) {
+            printf("%s\n", line);
         }
 
         /* Prints buffered input */
         if (to_print_input) {
             printf("\n%sInput:%s\n", CLR_G, CLR_0);
-            strarr_print(inp_arr, FRMT_ARR);
+            printf(FRMT_ARR, line);
             printf("\n");
         }
 
-        /* Parses input */
-        st_argv = parse(inp_arr);
-        strarr_del(&inp_arr);
+        /* Takes tree from parse cache (it is not used if parsed input is printed) */
+        Program *prog = NULL;
+        ShTree *st = to_print_pars ? NULL : pc_get(line, &prog);
+        if (st == NULL) {
+            /* Parses input */
+            Token *toks;
+            const int count = parse(line, &toks, line_ar);
+            phase_mark(PH_PARSE);
+
+            /* Prints parsed input */
+            if (to_print_pars) {
+                printf("\n%sParsed input:%s\n", CLR_G, CLR_0);
+                for (int i = 0; i < count; ++i) {
+                    printf(FRMT_ARR, toks[i].str);
+                }
+                printf("\n");
+            }
 
-        /* Prints parsed input */
-        if (to_print_pars) {
-            printf("\n%sParsed input:%s\n", CLR_G, CLR_0);
-            strarr_print(st_argv, FRMT_ARR);
-            printf("\n");
+            /* Creates tree */
+            st = st_build(toks, count, line_ar);
+            if (!to_print_pars) {
+                prog = pc_put(st);
+            }
+            phase_mark(PH_BUILD);
+        } else {
+            phase_mark(PH_PARSE);
+        }
+        /* Compiles tree if it is not cached */
+        if (prog == NULL) {
+            prog = pg_compile(st, line_ar);
+            phase_mark(PH_COMPILE);
         }
-
-        /* Creates tree */
-        st = st_build(st_argv);
-        strarr_del(&st_argv);
 
         /* Prints tree */
         if (to_print_tree) {
@@ -170,17 +262,97 @@ main(int argc, char **argv)
             */
         }
 
+        /* Prints program */
+        if (to_print_prog) {
+            printf("\n%sProgram:%s\n", CLR_G, CLR_0);
+            pg_print(prog);
+        }
+
         /* Executes commands */
         if (to_exec) {
-            if (flags & 7) {
+            if (flags & (7 | 128)) {
                 printf("\n%sExecution:%s\n", CLR_G, CLR_0);
             }
-            shell_exec(st, bg_pp[1], &emerg_shutdown);
+            /* Output of the shell must precede output of commands */
+            fflush(stdout);
+            phase_mark(-1);
+            const double children = to_time_phases ? tm_children() : 0;
+            shell_run(prog, &emerg_shutdown);
+            phase_mark(PH_EXEC);
+            if (to_time_phases) {
+                ph_children += tm_children() - children;
+            }
+        }
+
+        /* Prints times and allocations of phases */
+        if (to_time_phases) {
+            phase_print();
+        }
+        if (to_count_allocs) {
+            phase_print_allocs();
         }
 
-        st_delete(st);
-        st = NULL;
+        /* Frees memory of the line at once */
+        ar_reset(line_ar);
+    }
+}
+
+void
+phase_mark(int ph)
+{
+    if (to_count_allocs) {
+        AlTotals now;
+        al_get(&now);
+        for (int k = 0; ph != -1 && k < AL_KINDS; ++k) {
+            ph_allocs[ph].count[k] += now.count[k] - mark_allocs.count[k];
+            ph_allocs[ph].bytes[k] += now.bytes[k] - mark_allocs.bytes[k];
+        }
+        mark_allocs = now;
+        const size_t peak = al_take_peak();
+        if (ph != -1 && peak > ph_peak[ph]) {
+            ph_peak[ph] = peak;
+        }
+    }
+    if (!to_time_phases) {
+        return;
+    }
+    const double real = tm_real();
+    const double cpu = tm_cpu();
+    if (ph != -1) {
+        ph_real[ph] += real - mark_real;
+        ph_cpu[ph] += cpu - mark_cpu;
     }
+    mark_real = real;
+    mark_cpu = cpu;
+}
+
+void
+phase_print(void)
+{
+    printf("\n%sTiming (wall / cpu, us):%s", CLR_G, CLR_0);
+    for (int ph = 0; ph < PH_COUNT; ++ph) {
+        printf(" %s %.1f / %.1f;", PH_NAMES[ph], ph_real[ph] * 1e6, ph_cpu[ph] * 1e6);
+        ph_real[ph] = ph_cpu[ph] = 0;
+    }
+    printf(" sons cpu %.1f\n", ph_children * 1e6);
+    ph_children = 0;
+    fflush(stdout);
+}
+
+void
+phase_print_allocs(void)
+{
+    printf("\n%sAllocations (count / bytes; peak of live heap bytes):%s\n", CLR_G, CLR_0);
+    printf("    %-8s %20s %20s %12s\n", "phase", "heap", "arena", "peak heap");
+    for (int ph = 0; ph < PH_COUNT; ++ph) {
+        printf("    %-8s %9ld / %-8zu %9ld / %-8zu %12zu\n", PH_NAMES[ph],
+                ph_allocs[ph].count[AL_HEAP], ph_allocs[ph].bytes[AL_HEAP],
+                ph_allocs[ph].count[AL_ARENA], ph_allocs[ph].bytes[AL_ARENA], ph_peak[ph]);
+        memset(ph_allocs + ph, 0, sizeof(*ph_allocs));
+        ph_peak[ph] = 0;
+    }
+    al_print(SITES_MAX);
+    fflush(stdout);
 }
 
 void
@@ -203,23 +375,22 @@ prompt(void) {
 void
 free_mem(void)
 {
-    if (inp_arr != NULL) {
-        strarr_del(&inp_arr);
-    }
-    if (st_argv != NULL) {
-        strarr_del(&st_argv);
-    }
-    if (st != NULL) {
-        st_delete(st);
+    if (line_ar != NULL) {
+        ar_delete(&line_ar);
     }
     if (test_fn != NULL) {
         free(test_fn);
     }
-    if (testfile != NULL) {
-        fclose(testfile);
+    if (inp != NULL) {
+        rd_delete(&inp);
+    }
+    if (inpfd != -1) {
+        close(inpfd);
     }
-    close(bg_pp[0]);
-    close(bg_pp[1]);
+    jb_delete();
+    pc_delete();
+    shell_delete();
+    vr_delete();
 }
 
 void
@@ -231,7 +402,7 @@ emerg_shutdown(void)
 void
 pplr_rate(ShTree *tree, int *counters, strarr *words)
 {
-    if (tree == NULL || tree->argv == NULL && tree->psubcmd == NULL) {
+    if (tree == NULL || (tree->argv == NULL && tree->psubcmd == NULL)) {
         return;
     }
 
@@ -256,7 +427,7 @@ char *
 find_most_pplr(ShTree *tree, int *count)
 {
     int counters[4096] = { 0 }; /**/
-    strarr words = NULL;
+    strarr words = strarr_init();
 
     pplr_rate(tree, counters, &words);
 
@@ -0,0 +1,210 @@
+#define _GNU_SOURCE /* for splice and copy_file_range */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "mover.h"
+
+enum
+{
+    MOVE_CHUNK = 1 << 30, /* Maximal size of one kernel move */
+    BUF_SIZE = 1 << 16, /* Size of buffer of read-write copying */
+    STATUS_SIG = 128, /* Exit status of a process killed by signal is STATUS_SIG + signal number */
+};
+
+const char CAT_NAME[] = "cat";
+const char CAT_STDIN[] = "-";
+
+/* Methods of moving data; each returns 1 if all data is moved,
+ * 0 if the method is not supported for these descriptors (nothing is moved then), -1 in case of an error */
+
+/* The function moves data between regular files by copy_file_range */
+int _mv_copy_range(int in, int out);
+
+/* The function moves data from or to a pipe by splice */
+int _mv_splice(int in, int out);
+
+/* The function moves data from a regular file by sendfile */
+int _mv_sendfile(int in, int out);
+
+/* The function copies data through a buffer by read and write (it is always supported) */
+int _mv_copy(int in, int out);
+
+/* The function returns 1 if errno after a failed call means that the method is not supported */
+int _mv_unsupported(void);
+
+int
+mv_is_cat(char **argv)
+{
+    if (argv == NULL || argv[0] == NULL || strcmp(argv[0], CAT_NAME) != 0) {
+        return 0;
+    }
+    for (int i = 1; argv[i] != NULL; ++i) {
+        if (argv[i][0] == '-' && strcmp(argv[i], CAT_STDIN) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+_mv_unsupported(void)
+{
+    return errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF;
+}
+
+int
+_mv_copy_range(int in, int out)
+{
+    int moved = 0;
+    while (1) {
+        const ssize_t n = copy_file_range(in, NULL, out, NULL, MOVE_CHUNK, 0);
+        if (n > 0) {
+            moved = 1;
+        } else if (n == 0) {
+            return 1;
+        } else if (errno != EINTR) {
+            return !moved && _mv_unsupported() ? 0 : -1;
+        }
+    }
+}
+
+int
+_mv_splice(int in, int out)
+{
+    int moved = 0;
+    while (1) {
+        const ssize_t n = splice(in, NULL, out, NULL, MOVE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n > 0) {
+            moved = 1;
+        } else if (n == 0) {
+            return 1;
+        } else if (errno != EINTR) {
+            return !moved && _mv_unsupported() ? 0 : -1;
+        }
+    }
+}
+
+int
+_mv_sendfile(int in, int out)
+{
+    int moved = 0;
+    while (1) {
+        const ssize_t n = sendfile(out, in, NULL, MOVE_CHUNK);
+        if (n > 0) {
+            moved = 1;
+        } else if (n == 0) {
+            return 1;
+        } else if (errno != EINTR) {
+            return !moved && _mv_unsupported() ? 0 : -1;
+        }
+    }
+}
+
+int
+_mv_copy(int in, int out)
+{
+    static char buf[BUF_SIZE];
+    while (1) {
+        ssize_t n = read(in, buf, BUF_SIZE);
+        if (n == 0) {
+            return 1;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (ssize_t done = 0; done < n; ) {
+            const ssize_t w = write(out, buf + done, n - done);
+            if (w == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            done += w;
+        }
+    }
+}
+
+int
+mv_fd(int in, int out)
+{
+    struct stat st_in, st_out;
+    if (fstat(in, &st_in) == -1 || fstat(out, &st_out) == -1) {
+        return -1;
+    }
+
+    /* Methods are tried from the most specific one; each moves data from the current offsets */
+    int res = 0;
+    if (S_ISREG(st_in.st_mode) && S_ISREG(st_out.st_mode)) {
+        res = _mv_copy_range(in, out);
+    }
+    if (res == 0 && (S_ISFIFO(st_in.st_mode) || S_ISFIFO(st_out.st_mode))) {
+        res = _mv_splice(in, out);
+    }
+    if (res == 0 && S_ISREG(st_in.st_mode)) {
+        res = _mv_sendfile(in, out);
+    }
+    if (res == 0) {
+        res = _mv_copy(in, out);
+    }
+    return res == 1 ? 0 : -1;
+}
+
+int
+mv_cat(char **argv, int in, int out)
+{
+    struct sigaction sa_old;
+    sigaction(SIGPIPE, &(struct sigaction){.sa_handler = SIG_IGN}, &sa_old);
+
+    struct stat st_out;
+    const int out_reg = fstat(out, &st_out) == 0 && S_ISREG(st_out.st_mode);
+
+    /* Without arguments cat moves its input */
+    char *stdin_argv[] = { (char *)CAT_NAME, (char *)CAT_STDIN, NULL };
+    if (argv[1] == NULL) {
+        argv = stdin_argv;
+    }
+
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        const char *fn = argv[i];
+        const int is_stdin = strcmp(fn, CAT_STDIN) == 0;
+        const int fd = is_stdin ? in : open(fn, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            fprintf(stderr, "%s: %s: %s\n", CAT_NAME, fn, strerror(errno));
+            ret = 1;
+        } else {
+            struct stat st_in;
+            if (out_reg && fstat(fd, &st_in) == 0 && st_in.st_dev == st_out.st_dev &&
+                    st_in.st_ino == st_out.st_ino && st_in.st_size > 0) {
+                fprintf(stderr, "%s: %s: input file is output file\n", CAT_NAME, fn);
+                ret = 1;
+            } else if (mv_fd(fd, out) == -1) {
+                if (errno == EPIPE) {
+                    ret = STATUS_SIG + SIGPIPE;
+                    if (!is_stdin) {
+                        close(fd);
+                    }
+                    break;
+                }
+                fprintf(stderr, "%s: %s: %s\n", CAT_NAME, fn, strerror(errno));
+                ret = 1;
+            }
+            if (!is_stdin) {
+                close(fd);
+            }
+        }
+    }
+    fflush(stderr);
+
+    sigaction(SIGPIPE, &sa_old, NULL);
+    return ret;
+}
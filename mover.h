@@ -0,0 +1,18 @@
+/* The module implements data mover of plain "cat" stages:
+ * data is moved between descriptors by the kernel (copy_file_range, splice or sendfile)
+ * without passing through buffers of the process, so the shell needs no son for such a stage */
+#ifndef MOVER_H
+#define MOVER_H
+
+/* Returns 1 if command 'argv' is a plain cat (without options), which can be executed by mv_cat */
+int mv_is_cat(char **argv);
+
+/* Moves all data from descriptor 'in' to descriptor 'out'; returns 0 or -1 in case of an error (errno is set) */
+int mv_fd(int in, int out);
+
+/* Executes plain cat 'argv': moves files of arguments ("-" or no arguments mean 'in') to 'out';
+ * SIGPIPE is ignored while moving; returns exit status like cat
+ * (1 if a file can not be read, 128 + SIGPIPE if output is closed) */
+int mv_cat(char **argv, int in, int out);
+
+#endif
@@ -1,536 +1,367 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <ctype.h>
 #include <string.h>
+#include "arena.h"
 #include "strarr.h"
-#include "strarr_iter.h"
+#include "lexer.h"
 #include "shelltree.h"
 
+/* Masks of token kinds */
+#define TK_BIT(kind) (1 << (kind))
 enum
 {
-    BUF_SIZE = 1024, /* for variables */
+    TM_WORD = TK_BIT(TK_WORD),
+    TM_LPAREN = TK_BIT(TK_LPAREN),
+    TM_RPAREN = TK_BIT(TK_RPAREN),
+    TM_REDIR = TK_BIT(TK_LT) | TK_BIT(TK_GT) | TK_BIT(TK_GTGT) |
+            TK_BIT(TK_DUPOUT) | TK_BIT(TK_DUPIN) | TK_BIT(TK_RDWR) | TK_BIT(TK_HERESTR),
+    TM_CONN = TK_BIT(TK_PIPE) | TK_BIT(TK_OROR) | TK_BIT(TK_ANDAND),
+    TM_SEP = TK_BIT(TK_AMP) | TK_BIT(TK_SEMI),
+    TM_TIME = TK_BIT(TK_TIME),
 };
 
-/* Key characters */
-const char QUOT[] = "\'\"";
-const char SPACES[] = " \t\n";
-const char UNARY[] = ";<>&|";
-const char DOUBLE[] = ">&|";
-const char L_BRACKET = '(';
-const char R_BRACKET = ')';
-const char VAR = '$';
-const char SLASH = '\\';
-const char COMMENT = '#';
-
-/* End tokens */
-strarr ENDS_PIPE   = (char *[]){ "&&", "||", NULL }; /* After pipe */
-strarr ENDS_NEXTIF = (char *[]){ NULL }; /* After next-if */
-strarr ENDS_DFLT   = (char *[]){ NULL }; /* Default */
-
-extern char BASH_NAME[];
-
-/* Supported variables */
-const char * const VARS[] = { "HOME", "SHELL", "USER", "EUID", NULL };
+enum
+{
+    TK_END = -1, /* Kind of the position after the last token (or after a syntax error) */
+    ENDS_PIPE = TK_BIT(TK_OROR) | TK_BIT(TK_ANDAND), /* End tokens after pipe */
+    ENDS_DFLT = 0, /* Default end tokens */
+};
 
-/* The function replaces a part of '*pstr' from 'pos' of length 'len_old' by 'frag' */
-void _str_repl(char **pstr, int pos, int len_old, char *frag);
+/* Syntax rules: kinds which may be the first token, the last token and the token after each kind */
+const int TM_FIRST = TM_TIME | TM_LPAREN | TM_REDIR | TM_WORD;
+const int TM_LAST = TM_RPAREN | TM_SEP | TM_WORD;
+const int TM_AFTER[] = {
+    [TK_WORD]   = TM_RPAREN | TM_REDIR | TM_CONN | TM_SEP | TM_WORD,
+    [TK_LPAREN] = TM_TIME | TM_LPAREN | TM_REDIR | TM_WORD,
+    [TK_RPAREN] = TM_RPAREN | TM_REDIR | TM_CONN | TM_SEP,
+    [TK_LT]     = TM_WORD,
+    [TK_GT]     = TM_WORD,
+    [TK_GTGT]   = TM_WORD,
+    [TK_PIPE]   = TM_LPAREN | TM_REDIR | TM_WORD,
+    [TK_OROR]   = TM_TIME | TM_LPAREN | TM_REDIR | TM_WORD,
+    [TK_ANDAND] = TM_TIME | TM_LPAREN | TM_REDIR | TM_WORD,
+    [TK_AMP]    = TM_TIME | TM_LPAREN | TM_RPAREN | TM_REDIR | TM_WORD,
+    [TK_SEMI]   = TM_TIME | TM_LPAREN | TM_RPAREN | TM_REDIR | TM_WORD,
+    [TK_DUPOUT] = TM_WORD,
+    [TK_DUPIN]  = TM_WORD,
+    [TK_RDWR]   = TM_WORD,
+    [TK_HERESTR] = TM_WORD,
+    [TK_TIME]   = TM_LPAREN | TM_REDIR | TM_WORD,
+};
 
-/* The function returns copy of sequence after $ */
-char * _get_var(char *str, int pos);
+/* Modes and default descriptors of redirections (indexed by token kind) */
+const char RD_MODE[] = {
+    [TK_LT] = RD_IN, [TK_GT] = RD_OUT, [TK_GTGT] = RD_APP,
+    [TK_DUPOUT] = RD_DUP, [TK_DUPIN] = RD_DUP, [TK_RDWR] = RD_RDWR, [TK_HERESTR] = RD_STR,
+};
+const int RD_FD[] = {
+    [TK_LT] = 0, [TK_GT] = 1, [TK_GTGT] = 1,
+    [TK_DUPOUT] = 1, [TK_DUPIN] = 0, [TK_RDWR] = 0, [TK_HERESTR] = 0,
+};
 
-/* The function returns a value of supported variable */
-char * _get_var_val(char *var);
+extern char BASH_NAME[];
 
-/* The function replaces all variables in string */
-void _repl_var(char **pstr, strarr vars);
+/* State of parser: the tree is built and its syntax is checked in one pass over tokens */
+typedef struct
+{
+    Token *toks; /* Tokens */
+    int count; /* Number of tokens */
+    int pos; /* Position of the current token */
+    short kind; /* Kind of the current token or TK_END */
+    int brck; /* Count of left brackets minus count of right brackets before the current token */
+    int err; /* Syntax error code or 0 */
+    StPool pool; /* Pool of nodes */
+} Parser;
+
+enum PSFRAMES /* Values of PsFrame.type */
+{
+    FR_CMD = 1, /* One command with its pipe and next commands, until a token of 'ends' mask */
+    FR_SEQ = 2, /* Command sequence until ; or & with the following sequences, until ) or the end */
+};
 
-/* The function replaces escape sequences in string;
- * if 'seq' is NULL, then processes any character;
- * otherwise processes only characters from 'seq' */
-void _repl_escape(char **pstr, const char *seq);
+enum PSSLOTS /* Values of PsFrame.slot: field of the frame which receives the tree of the upper frame */
+{
+    SL_NONE = 0, /* The frame is not waiting */
+    SL_PIPE = 1, /* Pipe command */
+    SL_NEXT = 2, /* Next command */
+    SL_SUBCMD = 3, /* Commands in brackets */
+    SL_FIRST = 4, /* The first sequence of FR_SEQ */
+    SL_REST = 5, /* The following sequences of FR_SEQ */
+};
 
-/* The function returns a fragment ['begin', 'end') of 'arr' */
-char * _cut(strarr arr, const sait begin, const sait end);
+enum
+{
+    FRAMES_MIN = 16, /* Initial capacity of the stack of frames */
+};
 
-/* The function adds a fragment ['begin', 'end') of 'src' to '*dst';
- * if to_repl_esc set on 1, then replaces escape sequences */
-void _strarr_addn(strarr *dst, strarr src, const sait begin, const sait end, int to_repl_esc, const char *seq);
+/* Frame of the stack of the builder: the state of a command or a sequence which waits for a nested one;
+ * so chain length and nesting depth are limited by memory and not by the size of the call stack */
+typedef struct
+{
+    short type; /* Type of frame */
+    short slot; /* Field which receives the tree of the upper frame */
+    int ends; /* End tokens of FR_CMD */
+    strarr argv; /* Fields of the command */
+    Redir *redirs;
+    Redir **rd_tail;
+    short backgrnd;
+    ShTree *psubcmd; /* Commands in brackets of FR_CMD or the first sequence of FR_SEQ */
+    ShTree *pipe;
+    ShTree *next;
+    short nextmode;
+    short timed;
+} PsFrame;
+
+/* Stack of frames */
+typedef struct
+{
+    PsFrame *frames; /* Frames from the bottom */
+    int depth; /* Number of frames */
+    int cap; /* Capacity */
+} PsStack;
 
-/* The function returns a category of a string for _check_syntax function */
-int _ctg(const char *str);
+/* All strings and arrays are allocated in the arena of pool, and nodes of trees are taken from the pool;
+ * subtrees and arrays are moved into their parent nodes without copying */
 
-/* The function checks if the syntax is correct;
- * if syntax is correct, returns 0;
- * otherwise returns error code */
-int _check_syntax(strarr arr);
+/* The function moves parser to the next token and checks the syntax rules for it;
+ * in case of an error, remembers its code and moves to the end:
+ * 1: wrong first token, 2: wrong token after the previous one, 3: extra right bracket,
+ * 4: wrong last token, 5: unclosed bracket */
+void _ps_next(Parser *ps);
 
-/* The function creates and returns ShTree by one part of parsed strarr */
-ShTree * _st_create_one_tree(strarr arr, int *pos, strarr ends);
+/* The function pushes to 'stack' a frame of 'type' with end tokens 'ends';
+ * a frame of a command skips the token before the command */
+void _ps_push(Parser *ps, PsStack *stack, short type, int ends);
 
-/* The function creates and returns ShTree of one command sequence (until ; or &) by part of parsed strarr */
-ShTree * _st_create_sub_and_next(strarr arr, int *pos);
+/* The function continues command of frame 'fr' from the current token; returns the created ShTree
+ * of the command (with its pipe and next commands), or NULL if a nested frame is pushed */
+ShTree * _ps_cmd(Parser *ps, PsStack *stack, PsFrame *fr);
 
-void
-_str_repl(char **pstr, int pos, int len_old, char *frag)
-{
-    const int len_s = strlen(*pstr);
-    const int len_new = strlen(frag);
-    char *res = calloc(len_s - len_old + len_new + 1, sizeof(*res));
-    strncpy(res, *pstr, pos);
-    strcpy(res + pos, frag);
-    strcpy(res + pos + len_new, *pstr + pos + len_old);
-    free(*pstr);
-    *pstr = res;
-}
+/* The function continues command sequence of frame 'fr' (until ; or &, with the following sequences);
+ * returns the created ShTree or NULL if a nested frame is pushed */
+ShTree * _ps_seq(Parser *ps, PsStack *stack, PsFrame *fr);
 
-char *
-_get_var(char *str, int pos)
-{
-    register int i = pos;
-    while (i < strlen(str) && (isalnum(str[i]) || str[i] == '_')) {
-        ++i;
-    }
-    char *res = calloc(i - pos + 1, sizeof(*res));
-    strncpy(res, str + pos, i - pos);
-    return res;
-}
+/* The function creates and returns ShTree of command sequences until the end or an extra right bracket */
+ShTree * _st_create_tree(Parser *ps);
 
-char *
-_get_var_val(char *var)
+int
+parse(char *line, Token **ptoks, Arena *ar)
 {
-    if (strcmp(var, "EUID") == 0) {
-        char *res = calloc(BUF_SIZE, sizeof(*res));
-        sprintf(res, "%d", getuid());
-        return res;
+    const int count = lex(line, ptoks, ar);
+    if (count == -1) {
+        fprintf(stderr, "%s: lexycal error\n", BASH_NAME);
+        *ptoks = NULL;
+        return 0;
     }
-    char *tmp = getenv(var);
-    char *res = calloc(strlen(tmp) + 1, sizeof(*res));
-    strcpy(res, tmp);
-    return res;
+    return count;
 }
 
 void
-_repl_var(char **pstr, strarr vars)
+_ps_next(Parser *ps)
 {
-    int i = 0;
-    while (i < strlen(*pstr)) { /* Length of '*pstr' may change */
-        char c = (*pstr)[i];
-        if (c == '\\') {
-            i += 2;
-        } else if (c == '$') {
-            char *var = _get_var(*pstr, i + 1);
-            if (strlen(var) == 0) {
-                ++i;
-            } else {
-                int p = strarr_find(vars, var);
-                if (p == -1) {
-                    _str_repl(pstr, i, strlen(var) + 1, "");
-                } else {
-                    char *var_val = _get_var_val(var);
-                    _str_repl(pstr, i, strlen(var) + 1, var_val);
-                    i += strlen(var_val);
-                    free(var_val);
-                }
-            }
-            free(var);
-        } else {
-            ++i;
-        }
+    if (ps->kind == TK_END && ps->pos != -1) {
+        return;
     }
-}
-
-void
-_repl_escape(char **pstr, const char *seq)
-{
-    const int len = strlen(*pstr);
-    
-    /* Allocates tmp string (it may require less memory than allocated) */
-    char *tmp = calloc(len + 1, sizeof(*tmp));
-
-    /* Modifies string */
-    register int i = 0; /* Position in '*pstr' array */
-    register int j = 0; /* Position in 'tmp' array */
-    while (i < len - 1) {
-        if ((*pstr)[i] == SLASH && (seq == NULL || strchr(seq, (*pstr)[i + 1]) != NULL)) {
-            /* If finds escape sequence, replaces it */
-            tmp[j++] = (*pstr)[i + 1];
-            i += 2;
-        } else {
-            /* Otherwise copies character */
-            tmp[j++] = (*pstr)[i++];
+    const short prev = ps->kind;
+    ++ps->pos;
+    if (ps->pos == ps->count) {
+        /* Rules of the last token */
+        ps->kind = TK_END;
+        if (prev == TK_END) {
+            return;
         }
-    }
-    if (i == len - 1) {
-        tmp[j] = (*pstr)[i];
-    }
-
-    /* If more memory has been allocated than needed, then it is freed */
-    char *res = calloc(strlen(tmp) + 1, sizeof(*res));
-    strcpy(res, tmp);
-    free(tmp);
-
-    free(*pstr);
-    *pstr = res;
-}
-
-char *
-_cut(strarr arr, const sait begin, const sait end)
-{
-    /* Calculates result size */
-    register int size = 0;
-    if (begin[0] == end[0]) {
-        size += end[1] - begin[1];
-    } else {
-        size += strlen(arr[begin[0]]) - begin[1];
-        for (int i = begin[0] + 1; i < end[0]; ++i) {
-            size += strlen(arr[i]);
+        if (!(TK_BIT(prev) & TM_LAST)) {
+            ps->err = 4;
+        } else if ((prev == TK_RPAREN ? ps->brck - 1 : ps->brck) != 0) {
+            ps->err = 5;
         }
-        size += end[1];
+        return;
     }
 
-    /* Allocates memory for result string */
-    char *res = calloc(size + 1, sizeof(*res));
-    /* Fills result string */
-    if (begin[0] == end[0]) {
-        strncpy(res, arr[begin[0]] + begin[1], end[1] - begin[1]);
-    } else {
-        register int count = 0;
-        strncpy(res + count, arr[begin[0]] + begin[1], strlen(arr[begin[0]]) - begin[1]);
-        count += strlen(arr[begin[0]]) - begin[1];
-        for (int i = begin[0] + 1; i < end[0]; ++i) {
-            strncpy(res + count, arr[i], strlen(arr[i]));
-            count += strlen(arr[i]);
-        }
-        strncpy(res + count, arr[end[0]], end[1]);
+    ps->kind = ps->toks[ps->pos].kind;
+    if (!(TK_BIT(ps->kind) & (prev == TK_END ? TM_FIRST : TM_AFTER[prev]))) {
+        ps->err = prev == TK_END ? 1 : 2;
+    } else if (prev == TK_LPAREN) {
+        ++ps->brck;
+    } else if (prev == TK_RPAREN && --ps->brck < 0) {
+        ps->err = 3;
+    }
+    if (ps->err) {
+        ps->pos = ps->count;
+        ps->kind = TK_END;
     }
-
-    return res;
 }
 
 void
-_strarr_addn(strarr *dst, strarr src, const sait begin, const sait end, int to_repl_esc, const char *seq)
+_ps_push(Parser *ps, PsStack *stack, short type, int ends)
 {
-    /* Gets string */
-    char *tmp = _cut(src, begin, end);
-    /* Replaces variables */
-    _repl_var(&tmp, (strarr)VARS);
-    /* Replaces escape sequences if it necessary */
-    if (to_repl_esc) {
-        _repl_escape(&tmp, seq);
+    if (stack->depth == stack->cap) {
+        stack->cap = stack->cap == 0 ? FRAMES_MIN : 2 * stack->cap;
+        stack->frames = realloc(stack->frames, stack->cap * sizeof(*stack->frames));
+    }
+    PsFrame *fr = stack->frames + stack->depth++;
+    fr->type = type;
+    fr->slot = SL_NONE;
+    fr->ends = ends;
+    fr->argv = NULL;
+    fr->redirs = NULL;
+    fr->rd_tail = &fr->redirs;
+    fr->backgrnd = BG_OFF;
+    fr->psubcmd = NULL;
+    fr->pipe = NULL;
+    fr->next = NULL;
+    fr->nextmode = NM_ANY;
+    fr->timed = 0;
+
+    if (type == FR_CMD) {
+        fr->argv = strarr_init_ar(ps->pool.ar);
+        /* Skips the token before the command */
+        _ps_next(ps);
     }
-    /* Adds string to array */
-    strarr_add(dst, tmp);
-    /* Frees memory */
-    free(tmp);
 }
 
-strarr
-parse(strarr inarr)
+ShTree *
+_ps_cmd(Parser *ps, PsStack *stack, PsFrame *fr)
 {
-    strarr outarr = strarr_init();
-
-    const int arr_size = strarr_len(inarr);
-    char quot = 0; /* Flag of quot marks: possible values: \0 or \" or \' */
-    const sait end = { arr_size, 0 };
-    sait begin = { 0, 0 };
-    sait i = { 0, 0 };
-    sait tmp = { 0, 0 };
-    /* Iterates by characters */
-    while (sait_cmp(i, end)) {
-        char c = sait_ccur(inarr, i); /* Current character */
-        if (quot) { /* If inside quots */
-            if (c == quot) {
-                /* Adds the current word to array */
-                const char seq[] = { SLASH, VAR, quot, 0 };
-                _strarr_addn(&outarr, inarr, begin, i, 1, seq);
-                /* Sets quot flag on 0 */
-                quot = 0;
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (c == SLASH) {
-                /* Moves to the next-next character */
-                if (sait_rpos(inarr, i) != 1) {
-                    sait_incr(inarr, i, 2);
-                } else {
-                    sait_incr(inarr, i, 1);
-                }
-            } else {
-                /* Moves to the next character */
-                sait_incr(inarr, i, 1);
-            }
-        } else { /* If outside quots */
-            if (strchr(QUOT, c) != NULL) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Sets quot flag on c value */
-                quot = c;
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (c == L_BRACKET) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Adds "(" to array */
-                _strarr_addn(&outarr, inarr, i, (sait_asgn(tmp, i), sait_incr(inarr, tmp, 1), tmp), 0, NULL);
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (c == R_BRACKET) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Adds ")" to array */
-                _strarr_addn(&outarr, inarr, i, (sait_asgn(tmp, i), sait_incr(inarr, tmp, 1), tmp), 0, NULL);
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (strchr(SPACES, c) != NULL) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (sait_rpos(inarr, i) != 1 && c == sait_cnext(inarr, i, 1) && strchr(DOUBLE, c) != NULL) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Adds double key character to array */
-                _strarr_addn(&outarr, inarr, i, (sait_asgn(tmp, i), sait_incr(inarr, tmp, 2), tmp), 0, NULL);
-                /* Moves to the next word (moves to the next-next character and set begin marker on it) */
-                sait_incr(inarr, i, 2);
-                sait_asgn(begin, i);
-            } else if (strchr(UNARY, c) != NULL) {
-                /* Adds the previous word to array */
-                if (sait_cmp(begin, i)) _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-                /* Adds unary key character to array */
-                _strarr_addn(&outarr, inarr, i, (sait_asgn(tmp, i), sait_incr(inarr, tmp, 1), tmp), 0, NULL);
-                /* Moves to the next word (moves to the next character and set begin marker on it) */
-                sait_incr(inarr, i, 1);
-                sait_asgn(begin, i);
-            } else if (c == SLASH) {
-                /* Moves to the next-next character */
-                if (sait_rpos(inarr, i) != 1) {
-                    sait_incr(inarr, i, 2);
-                } else {
-                    sait_incr(inarr, i, 1);
-                }
-            } else if (c == COMMENT) {
-                /* Stops reading */
+    int is_end = 0;
+    while (!is_end && ps->kind != TK_END && !(TK_BIT(ps->kind) & fr->ends)) {
+        switch (ps->kind) {
+        case TK_LT:
+        case TK_GT:
+        case TK_GTGT:
+        case TK_DUPOUT:
+        case TK_DUPIN:
+        case TK_RDWR:
+        case TK_HERESTR: {
+            const Token *op = ps->toks + ps->pos;
+            _ps_next(ps);
+            if (ps->kind != TK_WORD) {
                 break;
-            } else {
-                /* Moves to the next character */
-                sait_incr(inarr, i, 1);
             }
+            Redir *rd = ar_alloc(ps->pool.ar, sizeof(*rd));
+            rd->fd = op->fd != -1 ? op->fd : RD_FD[op->kind];
+            rd->mode = RD_MODE[op->kind];
+            rd->word = ps->toks[ps->pos].str;
+            rd->next = NULL;
+            *fr->rd_tail = rd;
+            fr->rd_tail = &rd->next;
+            _ps_next(ps);
+            break;
+        }
+        case TK_PIPE:
+            fr->slot = SL_PIPE;
+            _ps_push(ps, stack, FR_CMD, ENDS_PIPE);
+            return NULL;
+        case TK_ANDAND:
+        case TK_OROR:
+            fr->nextmode = ps->kind == TK_ANDAND ? NM_SUC : NM_ERR;
+            fr->slot = SL_NEXT;
+            _ps_push(ps, stack, FR_CMD, ENDS_DFLT);
+            return NULL;
+        case TK_AMP:
+            fr->backgrnd = BG_ON;
+            is_end = 1;
+            break;
+        case TK_SEMI:
+        case TK_RPAREN:
+            is_end = 1;
+            break;
+        case TK_LPAREN:
+            fr->slot = SL_SUBCMD;
+            _ps_push(ps, stack, FR_SEQ, ENDS_DFLT);
+            return NULL;
+        case TK_TIME:
+            fr->timed = 1;
+            _ps_next(ps);
+            break;
+        default:
+            strarr_push(&fr->argv, ps->toks[ps->pos].str);
+            _ps_next(ps);
+            break;
         }
-    }
-    /* If there is one more word, then adds it to array */
-    if (sait_cmp(begin, i)) {
-        _strarr_addn(&outarr, inarr, begin, i, 1, NULL);
-    }
-
-    if (quot) {
-        fprintf(stderr, "%s: lexycal error\n", BASH_NAME);
-        strarr_del(&outarr);
-        return strarr_init();
     }
 
-    return outarr;
+    ShTree *st = st_make(&ps->pool, fr->argv, fr->redirs, fr->backgrnd, fr->psubcmd, fr->pipe, fr->next,
+            fr->nextmode);
+    st->subshell = fr->psubcmd != NULL;
+    st->timed = fr->timed;
+    return st;
 }
 
-int
-_ctg(const char *str)
-{
-    /* Categories:
-     *  1: (
-     *  2: )
-     *  4: < > >>
-     *  8: | || &&
-     * 16: & ;
-     * 32: other
-     * */
-
-    if (!strcmp(str, "(")) {
-        return 1;
-    } else if (!strcmp(str, ")")) {
-        return 2;
-    } else if (!strcmp(str, "<") || !strcmp(str, ">") || !strcmp(str, ">>")) {
-        return 4;
-    } else if (!strcmp(str, "|") || !strcmp(str, "||") || !strcmp(str, "&&")) {
-        return 8;
-    } else if (!strcmp(str, "&") || !strcmp(str, ";")) {
-        return 16;
-    } else {
-        return 32;
-    }
-}
-
-int
-_check_syntax(strarr arr)
+ShTree *
+_ps_seq(Parser *ps, PsStack *stack, PsFrame *fr)
 {
-    /* Categories:
-     *  1: (
-     *  2: )
-     *  4: < > >>
-     *  8: | || &&
-     * 16: & ;
-     * 32: other
-     *
-     * Rules:
-     *    First: | 1 - 4 - -- 32 |
-     * After  1: | 1 - 4 - -- 32 |
-     * After  2: | - 2 4 8 16 -- |
-     * After  4: | - - - - -- 32 |
-     * After  8: | 1 - 4 - -- 32 |
-     * After 16: | 1 2 4 - -- 32 |
-     * After 32: | - 2 4 8 16 32 |
-     *     Last: | - 2 - - 16 32 |
-     * + Bracket balance
-     * */
-    
-    const int arr_size = strarr_len(arr);
-    if (arr_size == 0) {
-        return 0;
-    }
-
-    /* Checks the first character */
-    const int ctg_first = _ctg(arr[0]);
-    if (ctg_first & ~(1 + 4 + 32)) {
-        return 1;
-    }
-
-    char brck = 0; /* Count of left brackets minus count of right brackets */
-    int i = 0;
-    while (i + 1 < arr_size) {
-        const char *str_cur = arr[i];
-        const char *str_nxt = arr[i + 1];
-        const int ctg_cur = _ctg(str_cur);
-        const int ctg_nxt = _ctg(str_nxt);
-        if (    ctg_cur == 1  && ctg_nxt & ~(1 + 4 + 32) ||
-                ctg_cur == 2  && ctg_nxt & ~(2 + 4 + 8 + 16) ||
-                ctg_cur == 4  && ctg_nxt & ~(32) ||
-                ctg_cur == 8  && ctg_nxt & ~(1 + 4 + 32) ||
-                ctg_cur == 16 && ctg_nxt & ~(1 + 2 + 4 + 32) ||
-                ctg_cur == 32 && ctg_nxt & ~(2 + 4 + 8 + 16 + 32)) {
-            return 2;
-        }
-        if (ctg_cur == 1) {
-            ++brck;
-        } else if (ctg_cur == 2) {
-            --brck;
+    switch (fr->slot) {
+    case SL_NONE:
+        fr->slot = SL_FIRST;
+        _ps_push(ps, stack, FR_CMD, ENDS_DFLT);
+        return NULL;
+    case SL_FIRST:
+        if (ps->kind == TK_RPAREN) {
+            _ps_next(ps);
+            return fr->psubcmd;
         }
-        if (brck < 0) {
-            return 3;
+        if (ps->pos + 1 < ps->count) {
+            fr->slot = SL_REST;
+            _ps_push(ps, stack, FR_SEQ, ENDS_DFLT);
+            return NULL;
         }
-        ++i;
+        return fr->psubcmd;
+    default:
+        return st_make(&ps->pool, strarr_init_ar(ps->pool.ar), NULL, BG_OFF, fr->psubcmd, NULL, fr->next, NM_ANY);
     }
-
-    /* Checks the last character */
-    const int ctg_last = _ctg(arr[i]);
-    if (ctg_last & ~(2 + 16 + 32)) {
-        return 4;
-    }
-    if (ctg_last == 2) {
-        --brck;
-    }
-    if (brck != 0) {
-        return 5;
-    }
-
-    return 0;
 }
 
-
 ShTree *
-_st_create_one_tree(strarr arr, int *pos, strarr ends)
+_st_create_tree(Parser *ps)
 {
-    strarr argv = strarr_init();
-    char *infile = NULL;
-    char *outfile = NULL;
-    char outmode = OM_WR;
-    short backgrnd = BG_OFF;
-    ShTree *psubcmd = NULL;
-    ShTree *pipe = NULL;
-    ShTree *next = NULL;
-    short nextmode = NM_ANY;
-
-    const int arr_size = strarr_len(arr);
-    int i = *pos + 1;
-    while (i < arr_size) {
-        if (strarr_find(ends, arr[i]) != -1) {
+    PsStack stack = { NULL, 0, 0 };
+    _ps_push(ps, &stack, FR_SEQ, ENDS_DFLT);
+
+    ShTree *tree = NULL;
+    while (1) {
+        PsFrame *fr = stack.frames + stack.depth - 1;
+        /* The tree of the finished upper frame is moved to its field */
+        switch (tree == NULL ? SL_NONE : fr->slot) {
+        case SL_PIPE:
+            fr->pipe = tree;
             break;
-        } else if (strcmp(arr[i], "<") == 0) {
-            infile = arr[i + 1];
-            i += 2;
-        } else if (strcmp(arr[i], ">") == 0) {
-            outfile = arr[i + 1];
-            outmode = OM_WR;
-            i += 2;
-        } else if (strcmp(arr[i], ">>") == 0) {
-            outfile = arr[i + 1];
-            outmode = OM_APP;
-            i += 2;
-        } else if (strcmp(arr[i], "|") == 0) {
-            pipe = _st_create_one_tree(arr, &i, ENDS_PIPE);
-        } else if (strcmp(arr[i], "&&") == 0) {
-            next = _st_create_one_tree(arr, &i, ENDS_NEXTIF);
-            nextmode = NM_SUC;
-        } else if (strcmp(arr[i], "||") == 0) {
-            next = _st_create_one_tree(arr, &i, ENDS_NEXTIF);
-            nextmode = NM_ERR;
-        } else if (strcmp(arr[i], ";") == 0) {
+        case SL_NEXT:
+        case SL_REST:
+            fr->next = tree;
             break;
-        } else if (strcmp(arr[i], "&") == 0) {
-            backgrnd = BG_ON;
+        case SL_SUBCMD:
+        case SL_FIRST:
+            fr->psubcmd = tree;
             break;
-        } else if (strcmp(arr[i], "(") == 0) {
-            psubcmd = _st_create_sub_and_next(arr, &i);
-        } else if (strcmp(arr[i], ")") == 0) {
+        }
+        if (fr->type == FR_CMD) {
+            fr->slot = SL_NONE;
+        }
+
+        tree = fr->type == FR_CMD ? _ps_cmd(ps, &stack, fr) : _ps_seq(ps, &stack, fr);
+        if (tree != NULL && --stack.depth == 0) {
             break;
-        } else {
-            strarr_add(&argv, arr[i]);
-            ++i;
         }
     }
-
-    *pos = i;
-    ShTree *res = st_create(argv, infile, outfile, outmode, backgrnd, psubcmd, pipe, next, nextmode);
-    strarr_del(&argv);
-    st_delete(psubcmd);
-    st_delete(pipe);
-    st_delete(next);
-    return res;
+    free(stack.frames);
+    return tree;
 }
 
 ShTree *
-_st_create_sub_and_next(strarr arr, int *pos)
+st_build(Token *toks, int count, Arena *ar)
 {
-    ShTree *tr;
+    Parser ps = { .toks = toks, .count = count, .pos = -1, .kind = TK_END };
+    stp_init(&ps.pool, ar);
+    ShTree *tree = _st_create_tree(&ps);
 
-    ShTree *tmp = _st_create_one_tree(arr, pos, ENDS_DFLT);
-    if (*pos < strarr_len(arr) && strcmp(arr[*pos], ")") == 0) {
-        ++(*pos);
-        tr = tmp;
-    } else if (*pos + 1 < strarr_len(arr)) {
-        tr = st_init();
-        tr->psubcmd = tmp;
-        tr->next = _st_create_sub_and_next(arr, pos);
-    } else {
-        tr = tmp;
+    /* Tokens after an extra right bracket are not used by the tree, but their syntax is checked */
+    while (ps.kind != TK_END) {
+        _ps_next(&ps);
     }
-
-    return tr;
-}
-
-ShTree *
-st_build(strarr arr)
-{
-    /* Checks syntax */
-    int syntax_code;
-    if (syntax_code = _check_syntax(arr)) {
-        fprintf(stderr, "%s: Invalid syntax: error code %d\n", BASH_NAME, syntax_code);
-        return st_init();
+    if (ps.err) {
+        fprintf(stderr, "%s: Invalid syntax: error code %d\n", BASH_NAME, ps.err);
+        return st_init(ar);
     }
-
-    int pos = -1;
-    return _st_create_sub_and_next(arr, &pos);
+    return tree;
 }
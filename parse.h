@@ -1,10 +1,15 @@
 #ifndef PARSE_H
 #define PARSE_H
 
-/* The function parses strarr */
-char ** parse(char **strarr);
+#include "lexer.h"
 
-/* The function creates and returns ShTree by parsed array */
-ShTree * st_build(char **arr);
+/* The function splits NUL-terminated string 'line' into tokens, writes array of them to '*ptoks'
+ * and returns their number (0 in case of a lexical error, which is reported);
+ * the result is allocated in arena 'ar' and may refer to 'line', which is modified */
+int parse(char *line, Token **ptoks, Arena *ar);
+
+/* The function creates and returns ShTree by 'count' tokens 'toks'; the tree is allocated in arena 'ar';
+ * syntax is checked by kinds of tokens in the same pass, and in case of an error an empty tree is returned */
+ShTree * st_build(Token *toks, int count, Arena *ar);
 
 #endif
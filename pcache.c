@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "strarr.h"
+#include "shelltree.h"
+#include "program.h"
+#include "pcache.h"
+
+enum
+{
+    BUCKETS = 256, /* Number of hash buckets (power of 2) */
+    ENTRIES_MAX = 256, /* Maximal number of cached trees */
+    BYTES_MAX = 4 << 20, /* Maximal memory of cached trees */
+    LINE_MAX_LEN = 4096, /* Longer lines are not cached */
+    KEY_MIN = 256, /* Initial capacity of key buffer */
+};
+
+/* Entry of the cache; all its data is allocated in its own arena */
+typedef struct pc_entry PcEntry;
+struct pc_entry
+{
+    char *key; /* Line */
+    int key_len; /* Length of key */
+    unsigned hash; /* Hash of key */
+    ShTree *tree; /* Cached tree */
+    Program *prog; /* Program of tree */
+    Arena *ar; /* Arena of the entry */
+    PcEntry *hnext; /* Next entry of the bucket */
+    PcEntry *prev; /* More recently used entry */
+    PcEntry *next; /* Less recently used entry */
+};
+
+PcEntry *pc_buckets[BUCKETS];
+PcEntry *pc_head = NULL; /* The most recently used entry */
+PcEntry *pc_tail = NULL; /* The least recently used entry */
+int pc_count = 0; /* Number of entries */
+size_t pc_bytes = 0; /* Memory of entries */
+
+/* Key of the last pc_get */
+char *pc_key = NULL;
+int pc_key_len = -1; /* -1 if the line can not be cached */
+int pc_key_cap = 0;
+unsigned pc_key_hash = 0;
+
+unsigned long pc_hits = 0;
+unsigned long pc_misses = 0;
+
+/* The function appends 'len' bytes of 'str' to the key */
+void _pc_key_add(const char *str, int len);
+
+/* The function makes key of line: variables are expanded when the program is executed,
+ * so the key is the line itself */
+void _pc_make_key(const char *line);
+
+/* The function returns hash of the key */
+unsigned _pc_hash(const char *key, int len);
+
+/* The function unlinks entry from the list of recently used entries */
+void _pc_unlink(PcEntry *ent);
+
+/* The function links entry to the head of the list of recently used entries */
+void _pc_link_head(PcEntry *ent);
+
+/* The function removes the least recently used entry */
+void _pc_evict(void);
+
+void
+_pc_key_add(const char *str, int len)
+{
+    if (pc_key_len + len > pc_key_cap) {
+        while (pc_key_len + len > pc_key_cap) {
+            pc_key_cap = pc_key_cap == 0 ? KEY_MIN : 2 * pc_key_cap;
+        }
+        pc_key = realloc(pc_key, pc_key_cap);
+    }
+    memcpy(pc_key + pc_key_len, str, len);
+    pc_key_len += len;
+}
+
+void
+_pc_make_key(const char *line)
+{
+    pc_key_len = 0;
+    _pc_key_add(line, strlen(line));
+    pc_key_hash = _pc_hash(pc_key, pc_key_len);
+}
+
+unsigned
+_pc_hash(const char *key, int len)
+{
+    /* FNV-1a */
+    register unsigned h = 2166136261u;
+    for (register int i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+void
+_pc_unlink(PcEntry *ent)
+{
+    if (ent->prev != NULL) {
+        ent->prev->next = ent->next;
+    } else {
+        pc_head = ent->next;
+    }
+    if (ent->next != NULL) {
+        ent->next->prev = ent->prev;
+    } else {
+        pc_tail = ent->prev;
+    }
+}
+
+void
+_pc_link_head(PcEntry *ent)
+{
+    ent->prev = NULL;
+    ent->next = pc_head;
+    if (pc_head != NULL) {
+        pc_head->prev = ent;
+    } else {
+        pc_tail = ent;
+    }
+    pc_head = ent;
+}
+
+void
+_pc_evict(void)
+{
+    PcEntry *ent = pc_tail;
+    _pc_unlink(ent);
+
+    PcEntry **pp = pc_buckets + (ent->hash & (BUCKETS - 1));
+    while (*pp != ent) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = ent->hnext;
+
+    --pc_count;
+    pc_bytes -= ar_size(ent->ar);
+    /* The entry itself is in its arena */
+    Arena *ar = ent->ar;
+    ar_delete(&ar);
+}
+
+ShTree *
+pc_get(const char *line, Program **pprog)
+{
+    if (strlen(line) > LINE_MAX_LEN) {
+        pc_key_len = -1;
+        ++pc_misses;
+        return NULL;
+    }
+    _pc_make_key(line);
+
+    for (PcEntry *ent = pc_buckets[pc_key_hash & (BUCKETS - 1)]; ent != NULL; ent = ent->hnext) {
+        if (ent->hash == pc_key_hash && ent->key_len == pc_key_len &&
+                memcmp(ent->key, pc_key, pc_key_len) == 0) {
+            _pc_unlink(ent);
+            _pc_link_head(ent);
+            ++pc_hits;
+            pc_key_len = -1;
+            *pprog = ent->prog;
+            return ent->tree;
+        }
+    }
+    ++pc_misses;
+    return NULL;
+}
+
+Program *
+pc_put(ShTree *tree)
+{
+    if (pc_key_len == -1) {
+        return NULL;
+    }
+    /* Empty tree is the result of empty line or of an error, which must be reported again */
+    if (strarr_len(tree->argv) == 0 && tree->psubcmd == NULL && tree->pipe == NULL && tree->next == NULL) {
+        pc_key_len = -1;
+        return NULL;
+    }
+
+    Arena *ar = ar_init();
+    PcEntry *ent = ar_alloc(ar, sizeof(*ent));
+    ent->ar = ar;
+    ent->key = ar_alloc(ar, pc_key_len);
+    memcpy(ent->key, pc_key, pc_key_len);
+    ent->key_len = pc_key_len;
+    ent->hash = pc_key_hash;
+    ent->tree = st_copy(ar, tree);
+    ent->prog = pg_compile(ent->tree, ar);
+    pc_key_len = -1;
+
+    PcEntry **bucket = pc_buckets + (ent->hash & (BUCKETS - 1));
+    ent->hnext = *bucket;
+    *bucket = ent;
+    _pc_link_head(ent);
+    ++pc_count;
+    pc_bytes += ar_size(ar);
+
+    /* The new entry itself is never evicted */
+    while (pc_count > 1 && (pc_count > ENTRIES_MAX || pc_bytes > BYTES_MAX)) {
+        _pc_evict();
+    }
+    return ent->prog;
+}
+
+void
+pc_print_stats(void)
+{
+    const unsigned long total = pc_hits + pc_misses;
+    printf("Parse cache: %lu hits, %lu misses (%.1f%% hits), %d entries, %zu bytes\n",
+            pc_hits, pc_misses, total == 0 ? 0.0 : 100.0 * pc_hits / total, pc_count, pc_bytes);
+}
+
+void
+pc_delete(void)
+{
+    while (pc_tail != NULL) {
+        _pc_evict();
+    }
+    free(pc_key);
+    pc_key = NULL;
+    pc_key_len = -1;
+    pc_key_cap = 0;
+}
@@ -0,0 +1,25 @@
+/* The module implements LRU cache of parse results: built ShTree and its program by input line;
+ * variables are expanded when the program is executed, so the key is the line itself */
+#ifndef PCACHE_H
+#define PCACHE_H
+
+#include "shelltree.h"
+#include "program.h"
+
+/* Returns cached tree of 'line' and writes its program to '*pprog', or returns NULL; the line is not modified;
+ * the tree and the program are valid until the next pc_put and must not be modified;
+ * in case of a miss, the key is remembered for pc_put */
+ShTree * pc_get(const char *line, Program **pprog);
+
+/* Stores a copy of 'tree' and its compiled program with the key of the last missed pc_get
+ * and returns the program; if the tree is not stored (e.g. it is empty), returns NULL;
+ * the least recently used trees are removed when the cache is full */
+Program * pc_put(ShTree *tree);
+
+/* Prints numbers of hits and misses and the size of the cache */
+void pc_print_stats(void);
+
+/* Frees the cache */
+void pc_delete(void);
+
+#endif
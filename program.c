@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "strarr.h"
+#include "colors.h"
+#include "lexer.h"
+#include "shelltree.h"
+#include "builtins.h"
+#include "mover.h"
+#include "program.h"
+
+enum
+{
+    CODE_MIN = 16, /* Initial capacity of code */
+    FRAMES_MIN = 16, /* Initial capacity of the stack of frames */
+};
+
+extern const char *CLR_DATA;
+extern const char *CLR_TAB;
+extern const char *FRMT_ARGV;
+
+/* Names of opcodes (indexed by opcode) */
+const char * const OP_NAMES[] = { NULL, "PIPE", "REDIR", "SPAWN", "SUBSH", "BUILTIN", "WAIT", "BG",
+        "JMPS", "JMPF", "END", "CAT", "TIME", "TIMES" };
+
+/* Growable code */
+typedef struct
+{
+    Instr *code; /* Instructions */
+    int len; /* Number of instructions */
+    int cap; /* Capacity */
+    Arena *ar; /* Arena where code is allocated */
+} PgBuf;
+
+enum PGSTEPS /* Values of PgFrame.step */
+{
+    PG_CMD = 1, /* Compiles the current command of sequence */
+    PG_STAGE = 2, /* Compiles the current stage of pipeline */
+    PG_STAGE_END = 3, /* Ends son of the stage whose commands in brackets are compiled by the upper frame */
+    PG_NEXT = 4, /* Goes to the next command of sequence */
+    PG_DONE = 0, /* The sequence is done */
+};
+
+/* Frame of the stack of the compiler (and of the printer of command text):
+ * the state of a command sequence which waits for commands in brackets;
+ * so chain length and nesting depth are limited by memory and not by the size of the call stack */
+typedef struct
+{
+    short step; /* Next step */
+    ShTree *tree; /* Current command of the sequence */
+    ShTree *stage; /* Next stage of its pipeline */
+    Builtin bi; /* Builtin of the command */
+    int has_cat; /* Whether a stage of the pipeline is executed by the shell */
+    int sub; /* Index of OP_SUBSH of the current stage */
+    int jmp; /* Index of the jump over the current command or -1 */
+} PgFrame;
+
+/* Stack of frames */
+typedef struct
+{
+    PgFrame *frames; /* Frames from the bottom */
+    int depth; /* Number of frames */
+    int cap; /* Capacity */
+} PgStack;
+
+/* The function adds instruction with opcode 'op' and returns its index */
+int _pg_emit(PgBuf *pb, short op);
+
+/* The function sets arguments 'argv' of instruction 'i' */
+void _pg_argv(PgBuf *pb, int i, char **argv);
+
+/* The function returns whether some of words 'argv' are templates which are expanded before execution */
+int _pg_templates(char **argv);
+
+/* The function adds redirections of 'stage' */
+void _pg_redirs(PgBuf *pb, ShTree *stage);
+
+/* The function returns 1 if 'stage' redirects only standard input and output to files
+ * (so that a plain cat stage can be executed by the shell) */
+int _pg_std_redirs(ShTree *stage);
+
+/* The function pushes to 'stack' a frame of sequence 'tree' */
+void _pg_push(PgStack *stack, ShTree *tree);
+
+/* The function does the next step of frame 'fr'; returns commands in brackets which should be compiled
+ * by a new frame before the next step, or NULL */
+ShTree * _pg_step(PgBuf *pb, PgFrame *fr);
+
+/* The function compiles 'tree' (pipelines, their redirections and the following commands) */
+void _pg_tree(PgBuf *pb, ShTree *tree);
+
+/* The function prints command text of pipeline 'tree' (or of sequence, if 'to_seq' is set) to 'f' */
+void _pg_fprint_cmd(FILE *f, ShTree *tree, int to_seq);
+
+/* The function returns command text of pipeline 'tree' allocated in arena 'ar' */
+char * _pg_cmd_text(ShTree *tree, Arena *ar);
+
+int
+_pg_emit(PgBuf *pb, short op)
+{
+    if (pb->len == pb->cap) {
+        pb->code = ar_realloc(pb->ar, pb->code, pb->cap * sizeof(Instr), 2 * pb->cap * sizeof(Instr));
+        pb->cap *= 2;
+    }
+    Instr *in = pb->code + pb->len;
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    in->target = -1;
+    return pb->len++;
+}
+
+void
+_pg_argv(PgBuf *pb, int i, char **argv)
+{
+    pb->code[i].argv = argv;
+    pb->code[i].expand = _pg_templates(argv);
+}
+
+int
+_pg_templates(char **argv)
+{
+    for (int j = 0; argv[j] != NULL; ++j) {
+        if (lex_to_expand(argv[j])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void
+_pg_redirs(PgBuf *pb, ShTree *stage)
+{
+    for (Redir *rd = stage->redirs; rd != NULL; rd = rd->next) {
+        const int i = _pg_emit(pb, OP_REDIR);
+        pb->code[i].mode = rd->mode;
+        pb->code[i].fd = rd->fd;
+        pb->code[i].file = rd->word;
+        pb->code[i].expand = lex_to_expand(rd->word);
+    }
+}
+
+int
+_pg_std_redirs(ShTree *stage)
+{
+    for (Redir *rd = stage->redirs; rd != NULL; rd = rd->next) {
+        if (!((rd->fd == 0 && rd->mode == RD_IN) || (rd->fd == 1 && (rd->mode == RD_OUT || rd->mode == RD_APP)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void
+_pg_fprint_cmd(FILE *f, ShTree *tree, int to_seq)
+{
+    PgStack stack = { NULL, 0, 0 };
+    _pg_push(&stack, tree);
+    while (stack.depth > 0) {
+        PgFrame *fr = stack.frames + stack.depth - 1;
+        ShTree *stage = fr->stage;
+        switch (fr->step) {
+        case PG_CMD:
+            if (fr->tree->timed) {
+                fputs("time ", f);
+            }
+            fr->stage = fr->tree;
+            fr->step = PG_STAGE;
+            break;
+        case PG_STAGE:
+            if (stage == NULL) {
+                fr->step = PG_NEXT;
+                break;
+            }
+            if (stage != fr->tree) {
+                fputs(" | ", f);
+            }
+            if (stage->argv != NULL && stage->argv[0] != NULL) {
+                for (int i = 0; stage->argv[i] != NULL; ++i) {
+                    fprintf(f, i ? " %s" : "%s", stage->argv[i]);
+                }
+            } else if (stage->psubcmd != NULL) {
+                /* Commands in brackets are printed as a sequence by a new frame */
+                fputs(stage->subshell ? "(" : "", f);
+                fr->step = PG_STAGE_END;
+                _pg_push(&stack, stage->psubcmd);
+                break;
+            }
+            rd_fprint(f, stage->redirs);
+            fr->stage = stage->pipe;
+            break;
+        case PG_STAGE_END:
+            fputs(stage->subshell ? ")" : "", f);
+            rd_fprint(f, stage->redirs);
+            fr->stage = stage->pipe;
+            fr->step = PG_STAGE;
+            break;
+        default:
+            /* The bottom frame prints only the pipeline unless 'to_seq' is set */
+            if (!to_seq && stack.depth == 1) {
+                --stack.depth;
+                break;
+            }
+            if (fr->tree->backgrnd == BG_ON) {
+                fputs(" &", f);
+            }
+            if (fr->tree->next == NULL) {
+                --stack.depth;
+                break;
+            }
+            if (fr->tree->nextmode == NM_SUC) {
+                fputs(" && ", f);
+            } else if (fr->tree->nextmode == NM_ERR) {
+                fputs(" || ", f);
+            } else {
+                fputs(fr->tree->backgrnd == BG_ON ? " " : "; ", f);
+            }
+            fr->tree = fr->tree->next;
+            fr->step = PG_CMD;
+            break;
+        }
+    }
+    free(stack.frames);
+}
+
+char *
+_pg_cmd_text(ShTree *tree, Arena *ar)
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&text, &size);
+    _pg_fprint_cmd(f, tree, 0);
+    fclose(f);
+    char *res = ar_strndup(ar, text, size);
+    free(text);
+    return res;
+}
+
+void
+_pg_push(PgStack *stack, ShTree *tree)
+{
+    if (stack->depth == stack->cap) {
+        stack->cap = stack->cap == 0 ? FRAMES_MIN : 2 * stack->cap;
+        stack->frames = realloc(stack->frames, stack->cap * sizeof(*stack->frames));
+    }
+    PgFrame *fr = stack->frames + stack->depth++;
+    fr->step = PG_CMD;
+    fr->tree = tree;
+    fr->stage = NULL;
+    fr->bi = NULL;
+    fr->has_cat = 0;
+    fr->sub = -1;
+    fr->jmp = -1;
+}
+
+ShTree *
+_pg_step(PgBuf *pb, PgFrame *fr)
+{
+    ShTree *tree = fr->tree;
+    switch (fr->step) {
+    case PG_CMD:
+        fr->bi = NULL;
+        if (tree->argv != NULL && tree->argv[0] != NULL) {
+            fr->bi = bi_find(tree->argv[0]);
+        }
+        if (tree->timed) {
+            _pg_emit(pb, OP_TIME);
+        }
+
+        fr->step = PG_NEXT;
+        if (tree->pipe == NULL && tree->backgrnd == BG_OFF &&
+                (fr->bi != NULL || (tree->psubcmd != NULL && !tree->subshell))) {
+            /* Builtins and command sequences are executed in the current process without fork,
+             * so that builtins (cd, exit, export, hash) change the shell itself */
+            if (fr->bi == NULL) {
+                return tree->psubcmd;
+            }
+            _pg_redirs(pb, tree);
+            const int i = _pg_emit(pb, OP_BUILTIN);
+            _pg_argv(pb, i, tree->argv);
+            pb->code[i].bi = fr->bi;
+        } else if (tree->pipe == NULL && tree->psubcmd == NULL && (tree->argv == NULL || tree->argv[0] == NULL) &&
+                tree->redirs == NULL) {
+            /* Empty command only sets status */
+            _pg_emit(pb, OP_WAIT);
+        } else {
+            /* Pipeline: one son for each stage; external commands are spawned,
+             * builtins and commands in brackets are executed in a forked son;
+             * one plain cat of a foreground pipeline is executed by the shell itself, others by a forked son */
+            fr->has_cat = tree->backgrnd == BG_ON;
+            fr->stage = tree;
+            fr->step = PG_STAGE;
+        }
+        return NULL;
+
+    case PG_STAGE: {
+        ShTree *stage = fr->stage;
+        if (stage == NULL) {
+            if (tree->backgrnd == BG_ON) {
+                const int i = _pg_emit(pb, OP_BG);
+                pb->code[i].text = _pg_cmd_text(tree, pb->ar);
+                pb->code[i].mode = tree->timed;
+            } else {
+                _pg_emit(pb, OP_WAIT);
+            }
+            fr->step = PG_NEXT;
+            return NULL;
+        }
+        fr->stage = stage->pipe;
+
+        if (stage->pipe != NULL) {
+            _pg_emit(pb, OP_PIPE);
+        }
+        _pg_redirs(pb, stage);
+
+        Builtin stage_bi = stage == tree ? fr->bi : NULL;
+        if (stage != tree && stage->argv != NULL && stage->argv[0] != NULL) {
+            stage_bi = bi_find(stage->argv[0]);
+        }
+        /* Arguments with variables may turn into options after expansion, so such cat is started as a command */
+        const int is_cat = stage_bi == NULL && mv_is_cat(stage->argv) && !_pg_templates(stage->argv) &&
+                _pg_std_redirs(stage);
+        if (is_cat && !fr->has_cat) {
+            const int i = _pg_emit(pb, OP_CAT);
+            _pg_argv(pb, i, stage->argv);
+            fr->has_cat = 1;
+            return NULL;
+        }
+        if (stage->argv != NULL && stage->argv[0] != NULL && stage_bi == NULL && !is_cat) {
+            const int i = _pg_emit(pb, OP_SPAWN);
+            _pg_argv(pb, i, stage->argv);
+            return NULL;
+        }
+
+        fr->sub = _pg_emit(pb, OP_SUBSH);
+        fr->step = PG_STAGE_END;
+        if (is_cat) {
+            const int i = _pg_emit(pb, OP_CAT);
+            _pg_argv(pb, i, stage->argv);
+            _pg_emit(pb, OP_WAIT);
+        } else if (stage_bi != NULL) {
+            const int i = _pg_emit(pb, OP_BUILTIN);
+            _pg_argv(pb, i, stage->argv);
+            pb->code[i].bi = stage_bi;
+        } else if (stage->psubcmd != NULL) {
+            return stage->psubcmd;
+        }
+        return NULL;
+    }
+
+    case PG_STAGE_END:
+        _pg_emit(pb, OP_END);
+        pb->code[fr->sub].target = pb->len;
+        fr->step = PG_STAGE;
+        return NULL;
+
+    default:
+        /* Times of a background job are printed when it finishes, not when it is started */
+        if (tree->timed && pb->code[pb->len - 1].op != OP_BG) {
+            _pg_emit(pb, OP_TIMES);
+        }
+        /* A skipped command keeps status, so the jump over it leads to the jump over the command after it:
+         * in a && b || c, c is executed if a or b fails */
+        if (fr->jmp != -1) {
+            pb->code[fr->jmp].target = pb->len;
+            fr->jmp = -1;
+        }
+        if (tree->next != NULL) {
+            if (tree->nextmode == NM_SUC) {
+                fr->jmp = _pg_emit(pb, OP_JMPF);
+            } else if (tree->nextmode == NM_ERR) {
+                fr->jmp = _pg_emit(pb, OP_JMPS);
+            }
+            fr->tree = tree->next;
+            fr->step = PG_CMD;
+            return NULL;
+        }
+        fr->step = PG_DONE;
+        return NULL;
+    }
+}
+
+void
+_pg_tree(PgBuf *pb, ShTree *tree)
+{
+    PgStack stack = { NULL, 0, 0 };
+    _pg_push(&stack, tree);
+    while (stack.depth > 0) {
+        PgFrame *fr = stack.frames + stack.depth - 1;
+        ShTree *sub = _pg_step(pb, fr);
+        if (sub != NULL) {
+            _pg_push(&stack, sub);
+        } else if (fr->step == PG_DONE) {
+            --stack.depth;
+        }
+    }
+    free(stack.frames);
+}
+
+Program *
+pg_compile(ShTree *tree, Arena *ar)
+{
+    PgBuf pb = { ar_alloc(ar, CODE_MIN * sizeof(Instr)), 0, CODE_MIN, ar };
+    _pg_tree(&pb, tree);
+    _pg_emit(&pb, OP_END);
+
+    Program *prog = ar_alloc(ar, sizeof(*prog));
+    prog->code = pb.code;
+    prog->len = pb.len;
+    return prog;
+}
+
+void
+pg_print(Program *prog)
+{
+    for (int i = 0; i < prog->len; ++i) {
+        const Instr *in = prog->code + i;
+        printf("%s%4d%s  %-8s", CLR_TAB, i, CLR_0, OP_NAMES[in->op]);
+        switch (in->op) {
+        case OP_REDIR: {
+            Redir rd = { in->fd, in->mode, in->file, NULL };
+            printf("%s", CLR_DATA);
+            rd_fprint(stdout, &rd);
+            printf("%s", CLR_0);
+            break;
+        }
+        case OP_SPAWN:
+        case OP_BUILTIN:
+        case OP_CAT:
+            printf(" ");
+            strarr_print(in->argv, FRMT_ARGV);
+            break;
+        case OP_BG:
+            printf(" %s%s%s", CLR_DATA, in->text, CLR_0);
+            break;
+        case OP_SUBSH:
+        case OP_JMPS:
+        case OP_JMPF:
+            printf(" -> %d", in->target);
+            break;
+        }
+        printf("\n");
+    }
+}
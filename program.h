@@ -0,0 +1,61 @@
+/* The module compiles ShTree into a program: a contiguous array of instructions
+ * which is executed in a loop without recursion (see shell_run) */
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "arena.h"
+#include "shelltree.h"
+#include "builtins.h"
+
+enum OPCODES /* Values of Instr.op */
+{
+    OP_PIPE = 1, /* Creates pipe from the next stage of pipeline to the stage after it */
+    OP_REDIR = 2, /* Adds redirection of descriptor 'fd' to the next stage: mode is one of REDIRMODES,
+                   * 'file' is its file, source descriptor or here-string; they are applied in order */
+    OP_SPAWN = 3, /* Starts external command 'argv' as the next stage */
+    OP_SUBSH = 4, /* Starts son as the next stage: son executes the following instructions until OP_END,
+                   * father continues at 'target' */
+    OP_BUILTIN = 5, /* Executes builtin 'bi' with arguments 'argv' in the current process */
+    OP_WAIT = 6, /* Waits all stages of pipeline and sets status */
+    OP_BG = 7, /* Adds stages of pipeline to jobs with command text 'text' and sets status to 0;
+                * if 'mode' is set, the job is timed since OP_TIME and its times are printed when it finishes */
+    OP_JMPS = 8, /* Jumps to 'target' if status is successful (0) */
+    OP_JMPF = 9, /* Jumps to 'target' if status is not successful */
+    OP_END = 10, /* Ends program (or son which is started by OP_SUBSH) with status */
+    OP_CAT = 11, /* Starts plain cat 'argv' as the next stage which is executed by the shell itself:
+                  * data is moved by the kernel when the pipeline is waited (one such stage in a pipeline) */
+    OP_TIME = 12, /* Starts measuring times of the next pipeline (reserved word "time") */
+    OP_TIMES = 13, /* Prints real, user and system time since OP_TIME (not emitted after OP_BG) */
+};
+
+typedef struct instr Instr;
+struct instr
+{
+    short op; /* Opcode */
+    char mode; /* Mode of redirection */
+    char expand; /* Whether words of 'argv' or 'file' are templates which are expanded before execution */
+    int target; /* Index of instruction for jumps and OP_SUBSH */
+    int fd; /* Redirected descriptor of OP_REDIR */
+    union {
+        char **argv; /* Command and arguments */
+        char *file; /* File of redirection */
+        char *text; /* Command text of job */
+    };
+    Builtin bi; /* Builtin of OP_BUILTIN */
+};
+
+typedef struct program Program;
+struct program
+{
+    Instr *code; /* Instructions; the last one is OP_END */
+    int len; /* Number of instructions */
+};
+
+/* Compiles 'tree' and returns program allocated in arena 'ar';
+ * the program refers to strings of the tree, so the tree must live as long as the program */
+Program * pg_compile(ShTree *tree, Arena *ar);
+
+/* Prints program */
+void pg_print(Program *prog);
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <assert.h>
+#include "reader.h"
+
+enum
+{
+    BLOCK_SIZE = 1 << 16, /* Initial size of buffer (and minimal size of one read) */
+    LINE_LONG = BLOCK_SIZE, /* Lines at least of this size are cut at separators */
+};
+
+/* Key characters of command scanning */
+const char RD_SLASH = '\\';
+const char RD_COMMENT = '#';
+
+struct reader
+{
+    int fd; /* File descriptor */
+    char *buf; /* Buffer */
+    int cap; /* Size of buffer */
+    int begin; /* Beginning of unprocessed data */
+    int end; /* End of unprocessed data */
+    int scan; /* Position from which the current line is scanned (data before it is already scanned) */
+    int eof; /* Whether end of file is reached */
+    /* State of scanning of the current line at 'scan' */
+    char quot; /* Quot mark which is open or 0 */
+    char esc; /* Whether the previous character is \\ */
+    char comment; /* Whether the rest of line is a comment */
+    int depth; /* Count of left brackets minus count of right brackets */
+    int sep; /* Offset from 'begin' of the end of the last separator ; or & outside quotes and brackets (0 if none) */
+    char saved; /* Character at 'begin' which is replaced by the terminator of the previous command (0 if none) */
+    char cutting; /* Whether the current line is long, so that each its command is returned as soon as it is read */
+    int watch_fd; /* Descriptor which is watched while waiting for input (-1 if none) */
+    void (*hook)(void); /* Handler of events of watch_fd */
+};
+
+/* The function moves unprocessed data to the beginning of buffer, grows buffer if it is full,
+ * and reads the next block; returns number of read bytes (0 if end of file is reached) */
+int _rd_fill(Reader *rd);
+
+/* The function scans data of the current line from 'scan' up to line feed or the end of data
+ * (if the line is being cut, also up to a separator); returns position of line feed or -1 */
+int _rd_scan(Reader *rd);
+
+Reader *
+rd_init(int fd)
+{
+    Reader *rd = calloc(1, sizeof(*rd));
+    rd->fd = fd;
+    rd->cap = BLOCK_SIZE;
+    rd->buf = malloc(rd->cap);
+    rd->watch_fd = -1;
+    return rd;
+}
+
+int
+_rd_fill(Reader *rd)
+{
+    /* Carries partial line to the beginning of buffer */
+    if (rd->begin > 0) {
+        memmove(rd->buf, rd->buf + rd->begin, rd->end - rd->begin);
+        rd->end -= rd->begin;
+        rd->scan -= rd->begin;
+        rd->begin = 0;
+    }
+    /* Grows buffer so that there is place for a block and a terminator */
+    if (rd->cap - rd->end < BLOCK_SIZE / 2) {
+        rd->cap *= 2;
+        rd->buf = realloc(rd->buf, rd->cap);
+    }
+
+    /* Handles events of the watched descriptor until input is ready */
+    while (rd->watch_fd != -1) {
+        struct pollfd fds[2] = {{.fd = rd->fd, .events = POLLIN}, {.fd = rd->watch_fd, .events = POLLIN}};
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            rd->hook();
+        }
+        if (fds[0].revents) {
+            break;
+        }
+    }
+
+    int size;
+    do {
+        size = read(rd->fd, rd->buf + rd->end, rd->cap - rd->end - 1);
+    } while (size == -1 && errno == EINTR);
+    if (size <= 0) {
+        rd->eof = 1;
+        return 0;
+    }
+    rd->end += size;
+    return size;
+}
+
+int
+_rd_scan(Reader *rd)
+{
+    register int i = rd->scan;
+    while (i < rd->end) {
+        const char c = rd->buf[i];
+        if (c == '\n') {
+            break;
+        }
+        if (rd->esc) {
+            rd->esc = 0;
+        } else if (rd->comment) {
+            /* Skips the comment */
+        } else if (rd->quot) {
+            if (c == RD_SLASH) {
+                rd->esc = 1;
+            } else if (c == rd->quot) {
+                rd->quot = 0;
+            }
+        } else if (c == RD_SLASH) {
+            rd->esc = 1;
+        } else if (c == '\'' || c == '"') {
+            rd->quot = c;
+        } else if (c == RD_COMMENT) {
+            rd->comment = 1;
+        } else if (c == '(') {
+            ++rd->depth;
+        } else if (c == ')') {
+            --rd->depth;
+        } else if (c == '&' && i > rd->begin && (rd->buf[i - 1] == '>' || rd->buf[i - 1] == '<')) {
+            /* & of >& or <& is not a separator */
+        } else if ((c == ';' || c == '&') && rd->depth == 0) {
+            if (c == '&' && i + 1 == rd->end && !rd->eof) {
+                /* Whether it is & or && is known after the next read */
+                break;
+            }
+            if (c == '&' && i + 1 < rd->end && rd->buf[i + 1] == '&') {
+                ++i;
+            } else {
+                rd->sep = i + 1 - rd->begin;
+                if (rd->cutting) {
+                    ++i;
+                    break;
+                }
+            }
+        }
+        ++i;
+    }
+    rd->scan = i;
+    return i < rd->end && rd->buf[i] == '\n' ? i : -1;
+}
+
+char *
+rd_cmd(Reader *rd, int *plen)
+{
+    assert(rd != NULL);
+
+    /* Restores the beginning of the current command */
+    if (rd->saved) {
+        rd->buf[rd->begin] = rd->saved;
+        rd->saved = 0;
+    }
+
+    int cut; /* End of the command */
+    int is_line = 1; /* Whether the command ends the line */
+    while ((cut = _rd_scan(rd)) == -1) {
+        /* A long line is cut after its last separator, and then after each separator,
+         * so that memory is bounded by the size of one command */
+        if (rd->sep > 0 && (rd->cutting || rd->end - rd->begin >= LINE_LONG)) {
+            rd->cutting = 1;
+            cut = rd->begin + rd->sep;
+            is_line = 0;
+            break;
+        }
+        if (rd->eof || _rd_fill(rd) == 0) {
+            /* The last line may have no line feed */
+            if (rd->scan < rd->end) {
+                continue;
+            }
+            if (rd->begin == rd->end) {
+                return NULL;
+            }
+            cut = rd->end;
+            break;
+        }
+    }
+
+    char *cmd = rd->buf + rd->begin;
+    const int len = cut - rd->begin;
+    if (plen != NULL) {
+        *plen = len;
+    }
+    if (is_line) {
+        rd->buf[cut] = '\0';
+        rd->begin += len + 1;
+        if (rd->begin > rd->end) {
+            rd->begin = rd->end;
+        }
+        rd->scan = rd->begin;
+        rd->quot = rd->esc = rd->comment = rd->cutting = 0;
+        rd->depth = 0;
+    } else {
+        /* The rest of line is not scanned again: the state after a separator is the same */
+        rd->saved = rd->buf[cut];
+        rd->buf[cut] = '\0';
+        rd->begin = cut;
+    }
+    rd->sep = 0;
+    return cmd;
+}
+
+void
+rd_watch(Reader *rd, int fd, void (*hook)(void))
+{
+    assert(rd != NULL);
+
+    rd->watch_fd = fd;
+    rd->hook = hook;
+}
+
+void
+rd_delete(Reader **prd)
+{
+    assert(prd != NULL);
+    assert(*prd != NULL);
+
+    free((*prd)->buf);
+    free(*prd);
+    *prd = NULL;
+}
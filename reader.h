@@ -0,0 +1,27 @@
+/* The module implements buffered reader of commands: it splits input into lines,
+ * and long lines into commands, as soon as they are read */
+#ifndef READER_H
+#define READER_H
+
+typedef struct reader Reader;
+
+/* Creates and returns reader of file descriptor 'fd' */
+Reader * rd_init(int fd);
+
+/* Returns the next line without line feed (NUL-terminated) and writes its length to '*plen';
+ * a line of 64 KiB or longer is returned in parts: each part ends after a separator ; or &
+ * which is outside quotes, brackets and comments, so that a command is never cut and memory is bounded
+ * by the size of one command rather than of the line; the scanning state is kept between reads;
+ * if there are no more lines, returns NULL;
+ * the result is stored in the buffer of reader and is valid (and may be modified) until the next call;
+ * data which is already in the buffer is returned without reading */
+char * rd_cmd(Reader *rd, int *plen);
+
+/* Makes reader wait also for descriptor 'fd' while there is no input:
+ * when 'fd' becomes readable, 'hook' is called (e.g. to handle events while the shell is idle) */
+void rd_watch(Reader *rd, int fd, void (*hook)(void));
+
+/* Deletes reader '*prd' (but does not close its file descriptor) and sets it to NULL */
+void rd_delete(Reader **prd);
+
+#endif
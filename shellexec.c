@@ -1,12 +1,26 @@
+#define _GNU_SOURCE /* for pipe2 and memfd_create */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <assert.h>
+#include <spawn.h>
+#include "arena.h"
+#include "lexer.h"
 #include "shelltree.h"
+#include "program.h"
+#include "cmdhash.h"
+#include "builtins.h"
+#include "jobs.h"
+#include "vars.h"
+#include "mover.h"
+#include "timing.h"
 
 enum ERRORS
 {
@@ -17,24 +31,105 @@ enum ERRORS
     ERR_OUTMODE = 5,
 };
 
+enum
+{
+    FD_SAVE_MIN = 10, /* Minimal descriptor for saved standard descriptors */
+    STATUS_SIG = 128, /* Exit status of a process killed by signal is STATUS_SIG + signal number */
+    PIDS_MIN = 16, /* Initial capacity of array of pipeline stages */
+    MV_PID = 0, /* Pid of a stage which is executed by the shell itself */
+    FD_NOT_SAVED = -2, /* Descriptor was saved by a previous redirection (see _apply_redirs) */
+    FD_DIGITS_MAX = 4, /* Maximal number of digits of source descriptor of redirection */
+};
+
+const char HERESTR_NAME[] = "here-string"; /* Name of anonymous file of here-string */
+
+/* State of pipeline which is being started */
+typedef struct
+{
+    int ipp; /* Input of the next stage (read end of pipe from the previous stage) */
+    int opp; /* Output of the next stage (write end of pipe) */
+    int next_ipp; /* Input of the stage after the next one (read end of pipe) */
+    const Instr *redirs; /* Redirections of the next stage (consecutive OP_REDIR instructions) */
+    int nredirs; /* Number of redirections of the next stage */
+    pid_t *pids; /* Started stages (-1 for a stage which was not started) */
+    int count; /* Number of started stages */
+    int cap; /* Capacity of pids */
+    int last_ret; /* Exit status of the last stage if it was not started */
+    char **mv_argv; /* Plain cat which is executed by the shell when the pipeline is waited (NULL if none) */
+    int mv_in; /* Input of the cat (-1 for standard input) */
+    int mv_out; /* Output of the cat (-1 for standard output) */
+    int mv_ret; /* Exit status of the cat */
+    double tm_begin; /* Real time of OP_TIME */
+    struct rusage tm_self; /* Resource usage of the shell at OP_TIME */
+    double tm_user; /* User time of the waited stages (from wait4) since OP_TIME */
+    double tm_sys; /* System time of the waited stages since OP_TIME */
+} PlState;
+
+int last_status = 0; /* Exit status of the last executed pipeline */
+Arena *sh_ar = NULL; /* Arena of expanded words of the running program; it is reset when the program ends */
+
 extern const char BASH_NAME[];
 
 /* The function closes file descriptor if it is open */
 void _close_fd(int fd);
 
-/* The function executes cmd with given input and output files or pipes */
-void _exec_io(char **argv, int ipp, int opp, char *inf, char *outf, char outmode, void (*emerg)(void));
+/* The function remembers exit status of the last pipeline: it is the value of $? and the status of exit */
+void _set_status(int status);
+
+/* The function returns arguments of instruction 'in' with expanded variables (see lex_expand) */
+char ** _expand_argv(const Instr *in);
+
+/* The function starts external command with given pipes and 'count' redirections 'rds' by posix_spawn
+ * (without copying the shell's memory) and returns its pid;
+ * files are opened by the shell and passed to the command as spawn file actions (dup2 in order);
+ * in case of an error prints it, writes exit status to '*pret' and returns -1 */
+pid_t _spawn(char **argv, int ipp, int opp, const Instr *rds, int count, int *pret);
+
+/* The function adds started stage 'pid' to pipeline and passes pipe to the following stage */
+void _pl_started(PlState *pl, pid_t pid);
 
-/* The function executes "cd" command */
-int _cd(char **argv);
+/* The function redirects standard descriptors of son started by OP_SUBSH to its input and output
+ * and resets pipeline state; in case of an error exits */
+void _pl_enter_son(PlState *pl, void (*emerg)(void));
 
-/* The function executes cmd with given input and output files or pipes and waits it */
-int _syst(char **argv, int ipp, int opp, char *inf, char *outf, char outmode, void (*emerg)(void));
+/* The function adds plain cat 'argv' to pipeline as a stage which is executed by the shell itself */
+void _pl_cat(PlState *pl, char **argv);
 
-/* The function executes shell commands of tree and returns exit status;
- * 'emerg' is a function that is called in son after fork if execution is failed */
-int _shell_exec(ShTree *tree, int ipp_ext, int opp_ext, char *inf_ext, char *outf_ext, char outmode_ext,
-        int bg_pp, void (*emerg)(void));
+/* The function executes the plain cat stage of pipeline (if any) after all other stages are started */
+void _pl_move(PlState *pl);
+
+/* The function waits all stages of pipeline and returns exit status of the last one;
+ * CPU times of the stages are added to the times of the pipeline;
+ * processes of background jobs which exit meanwhile are reaped at once */
+int _pl_wait(PlState *pl);
+
+/* The function starts measuring times of pipeline (OP_TIME) */
+void _pl_time(PlState *pl);
+
+/* The function prints times of pipeline since OP_TIME: time of the shell itself and of its waited stages */
+void _pl_times(PlState *pl);
+
+/* The function returns exit status by status of wait */
+int _status(int st);
+
+/* The function opens source of redirection 'rd' with O_CLOEXEC and returns its descriptor:
+ * file or here-string (in an anonymous file); for RD_DUP returns the source descriptor itself,
+ * which is not opened: it must be inherited by commands (descriptors of the shell itself are close-on-exec)
+ * or be set up by 'count' redirections before 'rd' or pipes 'ipp' and 'opp' of a spawned command,
+ * which are its preceding file actions; if file can not be opened or is a directory, prints error and returns -1 */
+int _open_redir(const Instr *rd, int count, int ipp, int opp);
+
+/* The function applies 'count' redirections 'rds' to descriptors of the current process in order;
+ * if 'saved' is not NULL, the replaced descriptors are saved there for _restore_redirs;
+ * in case of an error prints it, restores saved descriptors and returns -1 */
+int _apply_redirs(const Instr *rds, int count, int *saved);
+
+/* The function restores descriptors saved by the first 'count' redirections 'rds' */
+void _restore_redirs(const Instr *rds, int count, int *saved);
+
+/* The function executes builtin in the current process with 'count' redirections 'rds';
+ * the redirected descriptors are saved and restored */
+int _run_builtin(Builtin bi, char **argv, const Instr *rds, int count, void (*emerg)(void));
 
 void
 _close_fd(int fd)
@@ -45,201 +140,547 @@ _close_fd(int fd)
 }
 
 void
-_exec_io(char **argv, int ipp, int opp, char *inf, char *outf, char outmode, void (*emerg)(void))
+_set_status(int status)
 {
-    assert(argv != NULL);
+    last_status = status;
+    lex_set_status(status);
+}
 
-    if (inf != NULL) {
-        int infd = open(inf, O_RDONLY, 0444);
-        if (infd == -1) {
-            fprintf(stderr, "%s: %s: No such file or directory\n", BASH_NAME, inf);
-            fflush(stderr);
-            emerg();
-            _exit(ERR_OPEN);
+char **
+_expand_argv(const Instr *in)
+{
+    if (!in->expand) {
+        return in->argv;
+    }
+    int argc = 0;
+    while (in->argv[argc] != NULL) {
+        ++argc;
+    }
+    char **argv = ar_alloc(sh_ar, (argc + 1) * sizeof(*argv));
+    for (int i = 0; i < argc; ++i) {
+        argv[i] = lex_expand(in->argv[i], sh_ar);
+    }
+    argv[argc] = NULL;
+    return argv;
+}
+
+int
+_open_redir(const Instr *rd, int count, int ipp, int opp)
+{
+    const char *file = rd->expand ? lex_expand(rd->file, sh_ar) : rd->file;
+    int fd;
+    switch (rd->mode) {
+    case RD_DUP: {
+        const int len = strspn(file, "0123456789");
+        fd = len == 0 || len > FD_DIGITS_MAX || file[len] != '\0' ? -1 : atoi(file);
+        /* Other descriptors are taken from the shell if they are open without close-on-exec (F_GETFD gives 0) */
+        int is_set = (fd == 0 && ipp != -1) || (fd == 1 && opp != -1);
+        for (int i = 1; i <= count && !is_set; ++i) {
+            is_set = rd[-i].fd == fd;
         }
-        struct stat inf_stat;
-        stat(inf, &inf_stat);
-        if (S_ISDIR(inf_stat.st_mode)) {
-            fprintf(stderr, "%s: %s: Is a directory\n", BASH_NAME, inf);
+        if (fd == -1 || (!is_set && fcntl(fd, F_GETFD) != 0)) {
+            fprintf(stderr, "%s: %s: Bad file descriptor\n", BASH_NAME, file);
             fflush(stderr);
-            emerg();
-            _exit(ERR_OPEN);
-        }
-        dup2(infd, 0);
-        close(infd); /**/
-    } else if (ipp != -1) {
-        dup2(ipp, 0);
-    }
-    _close_fd(ipp);
-    
-    if (outf != NULL) {
-        int outfd;
-        if (outmode == OM_WR) {
-            outfd = open(outf, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-        } else if (outmode == OM_APP) {
-            outfd = open(outf, O_WRONLY | O_CREAT | O_APPEND, 0666);
-        } else {
-            _exit(ERR_OUTMODE);
+            return -1;
         }
-        struct stat outf_stat;
-        stat(outf, &outf_stat);
-        if (S_ISDIR(outf_stat.st_mode)) {
-            fprintf(stderr, "%s: %s: Is a directory\n", BASH_NAME, outf);
+        return fd;
+    }
+    case RD_STR: {
+        /* The text is read from the beginning of an anonymous file, so it may be of any size */
+        const size_t len = strlen(file);
+        fd = memfd_create(HERESTR_NAME, MFD_CLOEXEC);
+        if (fd == -1 || write(fd, file, len) != (ssize_t)len || write(fd, "\n", 1) != 1 ||
+                lseek(fd, 0, SEEK_SET) == -1) {
+            fprintf(stderr, "%s: %s: %s\n", BASH_NAME, HERESTR_NAME, strerror(errno));
             fflush(stderr);
-            emerg();
-            _exit(ERR_OPEN);
+            _close_fd(fd);
+            return -1;
         }
-        dup2(outfd, 1);
-        close(outfd); /**/
-    } else if (opp != -1) {
-        dup2(opp, 1);
+        return fd;
     }
-    _close_fd(opp);
-
-    execvp(argv[0], argv);
-    fprintf(stderr, "%s: exec: error\n", BASH_NAME);
-    fflush(stderr);
-    emerg();
-    _exit(ERR_EXEC);
+    case RD_IN:
+        fd = open(file, O_RDONLY | O_CLOEXEC);
+        break;
+    case RD_OUT:
+        fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        break;
+    case RD_APP:
+        fd = open(file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        break;
+    case RD_RDWR:
+        fd = open(file, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        break;
+    default:
+        return -1;
+    }
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s: %s\n", BASH_NAME, file, strerror(errno));
+        fflush(stderr);
+        return -1;
+    }
+    struct stat fd_stat;
+    fstat(fd, &fd_stat);
+    if (S_ISDIR(fd_stat.st_mode)) {
+        fprintf(stderr, "%s: %s: Is a directory\n", BASH_NAME, file);
+        fflush(stderr);
+        close(fd);
+        return -1;
+    }
+    return fd;
 }
 
 int
-_cd(char **argv)
+_apply_redirs(const Instr *rds, int count, int *saved)
 {
-    if (argv[1] == NULL || strcmp(argv[1], "~") == 0) {
-        return chdir(getenv("HOME"));
-    } else {
-        return chdir(argv[1]);
+    /* Buffered output belongs to the descriptors before redirection */
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < count; ++i) {
+        const Instr *rd = rds + i;
+        if (saved != NULL) {
+            /* Only the first redirection of a descriptor saves it (-1 means that it was closed) */
+            saved[i] = -1;
+            for (int j = 0; j < i; ++j) {
+                if (rds[j].fd == rd->fd) {
+                    saved[i] = FD_NOT_SAVED;
+                }
+            }
+            if (saved[i] == -1) {
+                saved[i] = fcntl(rd->fd, F_DUPFD_CLOEXEC, FD_SAVE_MIN);
+            }
+        }
+        const int src = _open_redir(rd, 0, -1, -1);
+        if (src == -1) {
+            if (saved != NULL) {
+                _restore_redirs(rds, i + 1, saved);
+            }
+            return -1;
+        }
+        if (src != rd->fd) {
+            dup2(src, rd->fd);
+            if (rd->mode != RD_DUP) {
+                close(src);
+            }
+        } else if (rd->mode != RD_DUP) {
+            /* The file is opened right on the closed descriptor */
+            fcntl(src, F_SETFD, 0);
+        }
     }
+    return 0;
 }
 
-int
-_syst(char **argv, int ipp, int opp, char *inf, char *outf, char outmode, void (*emerg)(void))
-{
-    pid_t frk = fork();
-    if (frk < 0) {
-        return ERR_FORK;
-    } else if (!frk) {
-        /* If command is cd */
-        if (argv != NULL && strcmp(argv[0], "cd") == 0) {
-            _close_fd(ipp);
-            _close_fd(opp);
-            return _cd(argv);
-        }
-        /* Otherwise */
-        _exec_io(argv, ipp, opp, inf, outf, outmode, emerg);
-    } else {
-        _close_fd(opp);
-        int st;
-        if (wait(&st) == -1) {
-            return ERR_WAIT;
+void
+_restore_redirs(const Instr *rds, int count, int *saved)
+{
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = count - 1; i >= 0; --i) {
+        if (saved[i] == FD_NOT_SAVED) {
+            continue;
         }
-        if (!WIFEXITED(st) || WEXITSTATUS(st)) {
-            return ERR_EXEC;
+        if (saved[i] == -1) {
+            close(rds[i].fd);
+        } else {
+            dup2(saved[i], rds[i].fd);
+            close(saved[i]);
         }
-        return 0;
     }
 }
 
-int
-_shell_exec(ShTree *tree, int ipp_ext, int opp_ext, char *inf_ext, char *outf_ext, char outmode_ext,
-        int bg_pp, void (*emerg)(void))
-{
-    /* Input-output priorities:
-     * 1) tree->infile | tree->outfile
-     * 2) pp[0]        | pp[1]
-     * 3) inf_ext      | outf_ext
-     * 4) ipp_ext      | opp_ext
-     * */
-
-    char *inf = tree->infile == NULL ? inf_ext : tree->infile;
-    char *outf = tree->outfile == NULL ? outf_ext : tree->outfile;
-    char outmode = tree->outfile == NULL ? outmode_ext : tree->outmode;
-
-    int ret = 0;
-
-    int frk1 = fork();
-    if (frk1 < 0) {
-        ret = ERR_FORK;
-    } else if (!frk1) {
-        /* Chanel for pipe command */
-        int pp[2];
-        pipe(pp);
-
-        int frk = fork();
-        if (frk < 0) {
-            /* If has error */
-            close(pp[0]);
-            close(pp[1]);
-            ret = ERR_FORK;
-        } else if (!frk) {
-            /* Son executes argv or psubcmd (exclude each other) */
-            close(pp[0]);
-            if (tree->argv != NULL && tree->argv[0] != NULL) {
-                if (tree->pipe != NULL) {
-                    ret = _syst(tree->argv, ipp_ext, pp[1], inf, tree->outfile, tree->outmode, emerg);
-                } else {
-                    ret = _syst(tree->argv, ipp_ext, opp_ext, inf, outf, outmode, emerg);
-                }
-            } else if (tree->psubcmd != NULL) {
-                if (tree->pipe != NULL) {
-                    ret = _shell_exec(tree->psubcmd, ipp_ext, pp[1], inf, tree->outfile, tree->outmode,
-                            bg_pp, emerg);
-                } else {
-                    ret = _shell_exec(tree->psubcmd, ipp_ext, opp_ext, inf, outf, outmode, bg_pp, emerg);
+pid_t
+_spawn(char **argv, int ipp, int opp, const Instr *rds, int count, int *pret)
+{
+    assert(argv != NULL);
+
+    /* Sources are opened with O_CLOEXEC, so only their copies on redirected descriptors remain after exec */
+    int srcs[count > 0 ? count : 1];
+    int min_fd = 0; /* Descriptors below it may be replaced by preceding file actions */
+    for (int i = 0; i < count; ++i) {
+        srcs[i] = _open_redir(rds + i, i, ipp, opp);
+        if (srcs[i] == -1) {
+            for (int j = 0; j < i; ++j) {
+                if (rds[j].mode != RD_DUP) {
+                    close(srcs[j]);
                 }
             }
-            close(pp[1]);
-            emerg(); /* Not emerg - just freemem */
-            _exit(ret);
-        } else {
-            /* Father executes pipe */
-            close(pp[1]);
-            if (tree->pipe != NULL) {
-                ret = _shell_exec(tree->pipe, pp[0], opp_ext, NULL, outf_ext, outmode_ext, bg_pp, emerg);
+            *pret = ERR_OPEN;
+            return -1;
+        }
+        if (rds[i].mode != RD_DUP && srcs[i] < min_fd) {
+            const int fd = fcntl(srcs[i], F_DUPFD_CLOEXEC, min_fd);
+            close(srcs[i]);
+            srcs[i] = fd;
+        }
+        if (rds[i].fd >= min_fd) {
+            min_fd = rds[i].fd + 1;
+        }
+    }
+
+    /* Sons get the signal mask which the shell had before blocking SIGCHLD */
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, jb_sigmask());
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (ipp != -1) {
+        posix_spawn_file_actions_adddup2(&fa, ipp, 0);
+    }
+    if (opp != -1) {
+        posix_spawn_file_actions_adddup2(&fa, opp, 1);
+    }
+    for (int i = 0; i < count; ++i) {
+        posix_spawn_file_actions_adddup2(&fa, srcs[i], rds[i].fd);
+    }
+
+    pid_t pid = -1;
+    int err = ENOENT;
+    const char *path = ch_lookup(argv[0]);
+    if (path != NULL) {
+        err = posix_spawn(&pid, path, &fa, &attr, argv, vr_envp());
+        /* If the remembered path is not valid anymore, searches the command again */
+        if (err == ENOENT && strchr(argv[0], '/') == NULL) {
+            ch_forget(argv[0]);
+            if ((path = ch_lookup(argv[0])) != NULL) {
+                err = posix_spawn(&pid, path, &fa, &attr, argv, vr_envp());
             }
-            close(pp[0]);
+        }
+    }
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+
+    for (int i = 0; i < count; ++i) {
+        if (rds[i].mode != RD_DUP) {
+            close(srcs[i]);
+        }
+    }
+    if (err) {
+        fprintf(stderr, "%s: exec: error\n", BASH_NAME);
+        fflush(stderr);
+        *pret = err == ENOENT ? ERR_EXEC : ERR_FORK;
+        return -1;
+    }
+    return pid;
+}
+
+int
+_status(int st)
+{
+    if (WIFEXITED(st)) {
+        return WEXITSTATUS(st);
+    }
+    if (WIFSIGNALED(st)) {
+        return STATUS_SIG + WTERMSIG(st);
+    }
+    return ERR_EXEC;
+}
+
+int
+_run_builtin(Builtin bi, char **argv, const Instr *rds, int count, void (*emerg)(void))
+{
+    int saved[count > 0 ? count : 1];
+    if (_apply_redirs(rds, count, saved) == -1) {
+        return ERR_OPEN;
+    }
+    const int ret = bi(argv, emerg);
+    _restore_redirs(rds, count, saved);
+    return ret;
+}
 
-            /* Waits son */
-            int st;
-            if (wait(&st) == -1) {
-                ret = ERR_WAIT;
+void
+_pl_started(PlState *pl, pid_t pid)
+{
+    if (pl->count == pl->cap) {
+        pl->cap = pl->cap == 0 ? PIDS_MIN : 2 * pl->cap;
+        pl->pids = realloc(pl->pids, pl->cap * sizeof(*pl->pids));
+    }
+    pl->pids[pl->count++] = pid;
+
+    /* Father keeps only the read end for the next stage */
+    _close_fd(pl->ipp);
+    _close_fd(pl->opp);
+    pl->ipp = pl->next_ipp;
+    pl->opp = -1;
+    pl->next_ipp = -1;
+    pl->redirs = NULL;
+    pl->nredirs = 0;
+}
+
+void
+_pl_enter_son(PlState *pl, void (*emerg)(void))
+{
+    /* Pipes are connected first, and redirections of the stage are applied over them */
+    if (pl->ipp != -1) {
+        dup2(pl->ipp, 0);
+        close(pl->ipp);
+    }
+    if (pl->opp != -1) {
+        dup2(pl->opp, 1);
+        close(pl->opp);
+    }
+    if (_apply_redirs(pl->redirs, pl->nredirs, NULL) == -1) {
+        emerg();
+        _exit(ERR_OPEN);
+    }
+    _close_fd(pl->next_ipp);
+    _close_fd(pl->mv_in);
+    _close_fd(pl->mv_out);
+    sigprocmask(SIG_SETMASK, jb_sigmask(), NULL);
+
+    pl->ipp = pl->opp = pl->next_ipp = -1;
+    pl->redirs = NULL;
+    pl->nredirs = 0;
+    pl->count = 0;
+    pl->last_ret = 0;
+    pl->mv_argv = NULL;
+    pl->mv_in = pl->mv_out = -1;
+}
+
+void
+_pl_cat(PlState *pl, char **argv)
+{
+    /* Only files of standard input and output are redirected here (see pg_compile) */
+    int infd = pl->ipp;
+    int outfd = pl->opp;
+    int in_file = 0;
+    int out_file = 0;
+    for (int i = 0; i < pl->nredirs; ++i) {
+        const int fd = _open_redir(pl->redirs + i, 0, -1, -1);
+        if (fd == -1) {
+            if (in_file) {
+                close(infd);
             }
-            if (!WIFEXITED(st) || WEXITSTATUS(st)) {
-                ret = ERR_EXEC;
+            if (out_file) {
+                close(outfd);
             }
-            
-            /* Adds process to bg pipe */
-            pid_t pid = getpid();
-            write(bg_pp, &pid, sizeof(pid));
-
-            emerg(); /* Not emerg - just freemem */
-            _exit(ret);
+            pl->last_ret = ERR_OPEN;
+            _pl_started(pl, -1);
+            return;
         }
-    } else {
-        if (tree->backgrnd == BG_OFF) {
-            int st;
-            if (wait(&st) == -1) {
-                ret = ERR_WAIT;
+        if (pl->redirs[i].fd == 0) {
+            if (in_file) {
+                close(infd);
             }
-            if (!WIFEXITED(st) || WEXITSTATUS(st)) {
-                ret = ERR_EXEC;
+            infd = fd;
+            in_file = 1;
+        } else {
+            if (out_file) {
+                close(outfd);
             }
+            outfd = fd;
+            out_file = 1;
         }
+    }
 
-        /* Moves to next */
-        if (tree->next != NULL) {
-            if (ret && tree->nextmode != NM_SUC || !ret && tree->nextmode != NM_ERR) {
-                ret = _shell_exec(tree->next, ipp_ext, opp_ext, inf_ext, outf_ext, outmode_ext,
-                        bg_pp, emerg);
+    /* The stage keeps its pipe ends until it is executed */
+    if (!in_file) {
+        pl->ipp = -1;
+    }
+    if (!out_file) {
+        pl->opp = -1;
+    }
+    pl->mv_argv = argv;
+    pl->mv_in = infd;
+    pl->mv_out = outfd;
+    pl->last_ret = 0;
+    _pl_started(pl, MV_PID);
+}
+
+void
+_pl_move(PlState *pl)
+{
+    if (pl->mv_argv == NULL) {
+        return;
+    }
+    /* Output of the shell must precede the moved data */
+    fflush(stdout);
+    pl->mv_ret = mv_cat(pl->mv_argv, pl->mv_in == -1 ? 0 : pl->mv_in, pl->mv_out == -1 ? 1 : pl->mv_out);
+    /* Closing of the output gives end of file to the next stage */
+    _close_fd(pl->mv_in);
+    _close_fd(pl->mv_out);
+    pl->mv_argv = NULL;
+    pl->mv_in = pl->mv_out = -1;
+}
+
+int
+_pl_wait(PlState *pl)
+{
+    /* Status of pipe is status of its last stage */
+    int ret = pl->last_ret;
+    int live = 0;
+    for (int i = 0; i < pl->count; ++i) {
+        if (pl->pids[i] == MV_PID && i == pl->count - 1) {
+            ret = pl->mv_ret;
+        } else if (pl->pids[i] != -1 && pl->pids[i] != MV_PID) {
+            ++live;
+        }
+    }
+
+    /* Any son is waited: a son which is not a process of a job is a stage */
+    const pid_t last = pl->count > 0 ? pl->pids[pl->count - 1] : -1;
+    while (live > 0) {
+        int st;
+        struct rusage ru;
+        const pid_t pid = wait4(-1, &st, 0, &ru);
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            ret = ERR_WAIT;
+            break;
+        }
+        if (jb_exited(pid, st, &ru)) {
+            continue;
+        }
+        --live;
+        pl->tm_user += tm_sec(&ru.ru_utime);
+        pl->tm_sys += tm_sec(&ru.ru_stime);
+        if (pid == last) {
+            ret = _status(st);
         }
     }
+    /* Drains notifications of the reaped sons */
+    jb_reap();
+    pl->count = 0;
+    pl->last_ret = 0;
     return ret;
 }
 
+void
+_pl_time(PlState *pl)
+{
+    pl->tm_begin = tm_real();
+    getrusage(RUSAGE_SELF, &pl->tm_self);
+    pl->tm_user = pl->tm_sys = 0;
+}
+
+void
+_pl_times(PlState *pl)
+{
+    struct rusage self;
+    getrusage(RUSAGE_SELF, &self);
+    /* Builtins and plain cat stages are executed by the shell itself, so its own time is added */
+    const double user = tm_sec(&self.ru_utime) - tm_sec(&pl->tm_self.ru_utime) + pl->tm_user;
+    const double sys = tm_sec(&self.ru_stime) - tm_sec(&pl->tm_self.ru_stime) + pl->tm_sys;
+    fflush(stdout);
+    tm_print(tm_real() - pl->tm_begin, user, sys);
+}
+
+int
+shell_run(Program *prog, void (*emerg)(void))
+{
+    if (sh_ar == NULL) {
+        sh_ar = ar_init();
+    }
+
+    PlState pl = { .ipp = -1, .opp = -1, .next_ipp = -1, .mv_in = -1, .mv_out = -1 };
+    /* Status of the previous pipeline is kept until the first pipeline of program ends (it is $?) */
+    int status = last_status;
+    lex_set_status(status);
+    int is_son = 0; /* Whether the process is a son started by OP_SUBSH */
+    register int pc = 0;
+    while (1) {
+        const Instr *in = prog->code + pc++;
+        switch (in->op) {
+        case OP_PIPE: {
+            int pp[2];
+            if (pipe2(pp, O_CLOEXEC) == -1) {
+                status = ERR_FORK;
+                _set_status(status);
+                break;
+            }
+            pl.opp = pp[1];
+            pl.next_ipp = pp[0];
+            break;
+        }
+        case OP_REDIR:
+            if (pl.nredirs++ == 0) {
+                pl.redirs = in;
+            }
+            break;
+        case OP_SPAWN: {
+            int ret = 0;
+            const pid_t pid = _spawn(_expand_argv(in), pl.ipp, pl.opp, pl.redirs, pl.nredirs, &ret);
+            pl.last_ret = ret;
+            _pl_started(&pl, pid);
+            break;
+        }
+        case OP_SUBSH: {
+            const pid_t pid = fork();
+            if (pid == 0) {
+                /* Son executes the following instructions until its OP_END */
+                _pl_enter_son(&pl, emerg);
+                is_son = 1;
+                break;
+            }
+            pl.last_ret = pid < 0 ? ERR_FORK : 0;
+            _pl_started(&pl, pid < 0 ? -1 : pid);
+            pc = in->target;
+            break;
+        }
+        case OP_BUILTIN:
+            status = _run_builtin(in->bi, _expand_argv(in), pl.redirs, pl.nredirs, emerg);
+            _set_status(status);
+            pl.redirs = NULL;
+            pl.nredirs = 0;
+            break;
+        case OP_CAT:
+            _pl_cat(&pl, _expand_argv(in));
+            break;
+        case OP_WAIT:
+            _pl_move(&pl);
+            status = _pl_wait(&pl);
+            _set_status(status);
+            break;
+        case OP_BG:
+            if (pl.count > 0) {
+                jb_add(pl.pids, pl.count, pl.last_ret, in->text, in->mode ? pl.tm_begin : -1);
+            }
+            pl.count = 0;
+            pl.last_ret = 0;
+            status = 0;
+            _set_status(status);
+            break;
+        case OP_TIME:
+            _pl_time(&pl);
+            break;
+        case OP_TIMES:
+            _pl_times(&pl);
+            break;
+        case OP_JMPS:
+            if (!status) {
+                pc = in->target;
+            }
+            break;
+        case OP_JMPF:
+            if (status) {
+                pc = in->target;
+            }
+            break;
+        case OP_END:
+            if (is_son) {
+                fflush(stdout);
+                emerg(); /* Not emerg - just freemem */
+                _exit(status);
+            }
+            free(pl.pids);
+            ar_reset(sh_ar);
+            return status;
+        }
+    }
+}
+
 int
-shell_exec(ShTree *tree, int bg_pp, void (*emerg)(void))
+shell_status(void)
 {
-    return _shell_exec(tree, -1, -1, NULL, NULL, OM_WR, bg_pp, emerg);
+    return last_status;
+}
+
+void
+shell_delete(void)
+{
+    if (sh_ar != NULL) {
+        ar_delete(&sh_ar);
+    }
 }
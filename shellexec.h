@@ -1,8 +1,14 @@
 #ifndef SHELLEXEC_H
 #define SHELLEXEC_H
 
-/* The function executes shell commands of tree and returns exit status;
+/* The function executes program (see pg_compile) in a loop and returns exit status;
  * 'emerg' is a function that is called in son after fork if execution is failed */
-int shell_exec(ShTree *tree, int bg_pp, void (*emerg)(void));
+int shell_run(Program *prog, void (*emerg)(void));
+
+/* The function returns exit status of the last executed pipeline (it is also the value of $?) */
+int shell_status(void);
+
+/* The function frees memory of the executor */
+void shell_delete(void);
 
 #endif
@@ -9,183 +9,319 @@
 enum
 {
     TAB_SIZE = 4, /* Size of tabulation for 'st_print' function */
+    POOL_BLOCK_MIN = 4, /* Number of nodes in the first block of pool */
+    POOL_BLOCK_MAX = 256, /* Maximal number of nodes in a block of pool */
+    FRAMES_MIN = 16, /* Initial capacity of the stack of frames */
 };
 
+enum STPRSTEPS /* Values of StFrame.step of st_print */
+{
+    PR_BEGIN = 0, /* Prints the node and its fields before psubcmd */
+    PR_SUBCMD = 1, /* Prints psubcmd */
+    PR_PIPE = 2, /* Prints pipe */
+    PR_NEXT = 3, /* Prints next */
+    PR_END = 4, /* Prints the fields after next and ends the node */
+};
+
+/* Frame of the stack of st_copy and st_print: a node which is waiting to be copied or printed;
+ * nodes are walked without recursion, so deep trees are limited by memory and not by the call stack */
+typedef struct
+{
+    ShTree *tree; /* Node */
+    ShTree **dst; /* Field which receives the copy of the node (st_copy) */
+    int tabs; /* Tabulation of the node (st_print) */
+    short step; /* Next step (st_print) */
+} StFrame;
+
+/* Stack of frames */
+typedef struct
+{
+    StFrame *frames; /* Frames from the bottom */
+    int depth; /* Number of frames */
+    int cap; /* Capacity */
+} StStack;
+
 /* Colors for tree print function */
 const char *CLR_DATA = CLR_G;
 const char *CLR_TAB  = CLR_C;
 const char *FRMT_ARGV = "[\033[033m%s\033[0m]";
 
-/* Allocates and returns a copy of a string */
-char * _strcopy(char *str);
+/* Returns a copy of list of redirections 'rd' allocated in arena 'ar' */
+Redir * _rd_copy(Arena *ar, Redir *rd);
+
+/* Pushes frame of node 'tree' to 'stack' */
+void _st_push(StStack *stack, ShTree *tree, ShTree **dst, int tabs);
 
-/* Prints colored tabulation */
-void _tab(char *tb);
+/* Prints colored tabulation of 'tabs' levels */
+void _tab(int tabs);
 
-/* Prints ShTree with given tabulation */
-void _st_print(ShTree *tree, int to_print_all, int tabs);
+/* Does the next step of printing node of frame 'fr', which may push a frame of its subtree */
+void _st_print_step(StStack *stack, StFrame *fr, int to_print_all);
 
-char *
-_strcopy(char *str)
+void
+stp_init(StPool *pool, Arena *ar)
 {
-    char *copy = calloc(strlen(str) + 1, sizeof(*str));
-    strcpy(copy, str);
-    return copy;
+    assert(ar != NULL);
+
+    pool->ar = ar;
+    pool->free = NULL;
+    pool->left = 0;
+    pool->block = 0;
 }
 
 ShTree *
-st_create(char **argv, char *infile, char *outfile, char outmode, short backgrnd,
+st_make(StPool *pool, char **argv, Redir *redirs, short backgrnd,
         ShTree *psubcmd, ShTree *pipe, ShTree *next, short nextmode)
 {
-    ShTree *st = calloc(1, sizeof(*st));
+    if (pool->left == 0) {
+        if (pool->block < POOL_BLOCK_MAX) {
+            pool->block = pool->block == 0 ? POOL_BLOCK_MIN : 2 * pool->block;
+        }
+        pool->free = ar_alloc(pool->ar, pool->block * sizeof(ShTree));
+        pool->left = pool->block;
+    }
+    ShTree *st = pool->free++;
+    --pool->left;
 
-    st->argv     =     argv == NULL ? NULL : strarr_cp(argv);
-    st->infile   =   infile == NULL ? NULL : _strcopy(infile);
-    st->outfile  =  outfile == NULL ? NULL : _strcopy(outfile);
-    st->outmode  = outmode;
+    st->argv     = argv;
+    st->redirs   = redirs;
     st->backgrnd = backgrnd;
-    st->pipe     =     pipe == NULL ? NULL : st_copy(pipe);
-    st->psubcmd  =  psubcmd == NULL ? NULL : st_copy(psubcmd);
-    st->next     =     next == NULL ? NULL : st_copy(next);
+    st->psubcmd  = psubcmd;
+    st->subshell = 0;
+    st->pipe     = pipe;
+    st->next     = next;
     st->nextmode = nextmode;
+    st->timed    = 0;
 
     return st;
 }
 
 ShTree *
-st_init(void)
+st_create(Arena *ar, char **argv, Redir *redirs, short backgrnd,
+        ShTree *psubcmd, ShTree *pipe, ShTree *next, short nextmode)
 {
-    strarr void_arr = strarr_init();
-    ShTree *tmp = st_create(void_arr, NULL, NULL, OM_WR, BG_OFF, NULL, NULL, NULL, NM_ANY);
-    strarr_del(&void_arr);
-    return tmp;
+    assert(ar != NULL);
+
+    ShTree *st = ar_alloc(ar, sizeof(*st));
+
+    st->argv = NULL;
+    if (argv != NULL) {
+        st->argv = strarr_init_ar(ar);
+        const int argc = strarr_len(argv);
+        strarr_reserve(&(st->argv), argc);
+        for (int i = 0; i < argc; ++i) {
+            strarr_add(&(st->argv), argv[i]);
+        }
+    }
+    st->redirs   = _rd_copy(ar, redirs);
+    st->backgrnd = backgrnd;
+    st->pipe     =     pipe == NULL ? NULL : st_copy(ar, pipe);
+    st->psubcmd  =  psubcmd == NULL ? NULL : st_copy(ar, psubcmd);
+    st->subshell = 0;
+    st->next     =     next == NULL ? NULL : st_copy(ar, next);
+    st->nextmode = nextmode;
+    st->timed    = 0;
+
+    return st;
 }
 
 ShTree *
-st_copy(ShTree *tree)
+st_init(Arena *ar)
+{
+    return st_create(ar, strarr_init_ar(ar), NULL, BG_OFF, NULL, NULL, NULL, NM_ANY);
+}
+
+void
+_st_push(StStack *stack, ShTree *tree, ShTree **dst, int tabs)
+{
+    if (stack->depth == stack->cap) {
+        stack->cap = stack->cap == 0 ? FRAMES_MIN : 2 * stack->cap;
+        stack->frames = realloc(stack->frames, stack->cap * sizeof(*stack->frames));
+    }
+    StFrame *fr = stack->frames + stack->depth++;
+    fr->tree = tree;
+    fr->dst = dst;
+    fr->tabs = tabs;
+    fr->step = PR_BEGIN;
+}
+
+ShTree *
+st_copy(Arena *ar, ShTree *tree)
 {
     assert(tree != NULL);
 
-    return st_create(tree->argv, tree->infile, tree->outfile, tree->outmode, tree->backgrnd,
-            tree->psubcmd, tree->pipe, tree->next, tree->nextmode);
+    /* Each node is copied without its subtrees, and they are pushed with the fields of the copy */
+    ShTree *res = NULL;
+    StStack stack = { NULL, 0, 0 };
+    _st_push(&stack, tree, &res, 0);
+    while (stack.depth > 0) {
+        const StFrame fr = stack.frames[--stack.depth];
+        ShTree *src = fr.tree;
+        ShTree *st = st_create(ar, src->argv, src->redirs, src->backgrnd, NULL, NULL, NULL, src->nextmode);
+        st->subshell = src->subshell;
+        st->timed = src->timed;
+        *fr.dst = st;
+        if (src->next != NULL) {
+            _st_push(&stack, src->next, &st->next, 0);
+        }
+        if (src->pipe != NULL) {
+            _st_push(&stack, src->pipe, &st->pipe, 0);
+        }
+        if (src->psubcmd != NULL) {
+            _st_push(&stack, src->psubcmd, &st->psubcmd, 0);
+        }
+    }
+    free(stack.frames);
+    return res;
 }
 
-void
-_tab(char *tb)
+Redir *
+_rd_copy(Arena *ar, Redir *rd)
 {
-    printf("%s%s%s", CLR_TAB, tb, CLR_0);
+    Redir *res = NULL;
+    Redir **tail = &res;
+    for (; rd != NULL; rd = rd->next) {
+        Redir *copy = ar_alloc(ar, sizeof(*copy));
+        copy->fd = rd->fd;
+        copy->mode = rd->mode;
+        copy->word = ar_strdup(ar, rd->word);
+        copy->next = NULL;
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return res;
 }
 
 void
-_st_print(ShTree *tree, int to_print_all, int tabs)
+rd_fprint(FILE *f, Redir *rd)
 {
-    /* Creates tabulation strings */
-    char *tb = calloc(tabs * TAB_SIZE + 1, sizeof(*tb));
-    char *tb2 = calloc((tabs + 1) * TAB_SIZE + 1, sizeof(*tb2));
-    for (int i = 0; i < tabs; ++i) {
-        tb [i * TAB_SIZE] = ':';
-        tb2[i * TAB_SIZE] = ':';
-        for (int j = 1; j < TAB_SIZE; ++j) {
-            tb [i * TAB_SIZE + j] = ' ';
-            tb2[i * TAB_SIZE + j] = ' ';
+    for (; rd != NULL; rd = rd->next) {
+        const int is_in = rd->mode == RD_IN || rd->mode == RD_RDWR || rd->mode == RD_STR ||
+                (rd->mode == RD_DUP && rd->fd == 0);
+        /* Descriptor is omitted if it is the default one */
+        if (rd->fd != (is_in ? 0 : 1)) {
+            fprintf(f, " %d", rd->fd);
+        } else {
+            fputc(' ', f);
+        }
+        switch (rd->mode) {
+        case RD_IN:
+            fprintf(f, "< %s", rd->word);
+            break;
+        case RD_OUT:
+            fprintf(f, "> %s", rd->word);
+            break;
+        case RD_APP:
+            fprintf(f, ">> %s", rd->word);
+            break;
+        case RD_RDWR:
+            fprintf(f, "<> %s", rd->word);
+            break;
+        case RD_DUP:
+            fprintf(f, is_in ? "<&%s" : ">&%s", rd->word);
+            break;
+        case RD_STR:
+            fprintf(f, "<<< %s", rd->word);
+            break;
         }
     }
-    tb2[tabs * TAB_SIZE] = ':';
-    for (int j = 1; j < TAB_SIZE; ++j) {
-        tb2[tabs * TAB_SIZE + j] = ' ';
+}
+
+void
+_tab(int tabs)
+{
+    printf("%s", CLR_TAB);
+    for (int i = 0; i < tabs; ++i) {
+        printf(":%*s", TAB_SIZE - 1, "");
     }
+    printf("%s", CLR_0);
+}
 
-    if (tree == NULL) {
-        printf("NULL\n");
-    } else {
+void
+_st_print_step(StStack *stack, StFrame *fr, int to_print_all)
+{
+    ShTree *tree = fr->tree;
+    const int tabs = fr->tabs + 1; /* Tabulation of fields */
+    switch (fr->step) {
+    case PR_BEGIN:
+        if (tree == NULL) {
+            printf("NULL\n");
+            --stack->depth;
+            return;
+        }
         printf("{\n");
-
-        _tab(tb2);
+        _tab(tabs);
         printf("argv: ");
         strarr_print(tree->argv, FRMT_ARGV);
         printf("\n");
-        if (to_print_all) {
-            _tab(tb2);
-            printf("infile: %s%s%s\n", CLR_DATA, tree->infile == NULL ? "NULL" : tree->infile, CLR_0);
-            _tab(tb2);
-            printf("outfile: %s%s%s\n", CLR_DATA, tree->outfile == NULL ? "NULL" : tree->outfile, CLR_0);
-            _tab(tb2);
-            printf("outmode: %s%c%s\n", CLR_DATA, tree->outmode, CLR_0);
-            _tab(tb2);
-            printf("backgrnd: %s%hi%s\n", CLR_DATA, tree->backgrnd, CLR_0);
-            _tab(tb2);
+        if (to_print_all || tree->redirs != NULL) {
+            _tab(tabs);
+            printf("redirs:%s", CLR_DATA);
+            if (tree->redirs == NULL) {
+                printf(" NULL");
+            }
+            rd_fprint(stdout, tree->redirs);
+            printf("%s\n", CLR_0);
+        }
+        _tab(tabs);
+        printf("backgrnd: %s%hi%s\n", CLR_DATA, tree->backgrnd, CLR_0);
+        if (!to_print_all && tree->timed) {
+            _tab(tabs);
+            printf("timed: %s%hi%s\n", CLR_DATA, tree->timed, CLR_0);
+        }
+        fr->step = PR_SUBCMD;
+        return;
+    case PR_SUBCMD:
+        fr->step = PR_PIPE;
+        if (to_print_all || tree->psubcmd != NULL) {
+            _tab(tabs);
             printf("psubcmd: ");
-            _st_print(tree->psubcmd, to_print_all, tabs + 1);
-            _tab(tb2);
+            _st_push(stack, tree->psubcmd, NULL, tabs);
+        }
+        return;
+    case PR_PIPE:
+        if (to_print_all) {
+            _tab(tabs);
+            printf("subshell: %s%hi%s\n", CLR_DATA, tree->subshell, CLR_0);
+        }
+        fr->step = PR_NEXT;
+        if (to_print_all || tree->pipe != NULL) {
+            _tab(tabs);
             printf("pipe: ");
-            _st_print(tree->pipe, to_print_all, tabs + 1);
-            _tab(tb2);
+            _st_push(stack, tree->pipe, NULL, tabs);
+        }
+        return;
+    case PR_NEXT:
+        fr->step = PR_END;
+        if (to_print_all || tree->next != NULL) {
+            _tab(tabs);
             printf("next: ");
-            _st_print(tree->next, to_print_all, tabs + 1);
-            _tab(tb2);
+            _st_push(stack, tree->next, NULL, tabs);
+        }
+        return;
+    default:
+        if (to_print_all || tree->next != NULL) {
+            _tab(tabs);
             printf("nextmode: %s%hi%s\n", CLR_DATA, tree->nextmode, CLR_0);
-        } else {
-            if (tree->infile != NULL) {
-                _tab(tb2);
-                printf("infile: %s%s%s\n", CLR_DATA, tree->infile, CLR_0);
-            }
-            if (tree->outfile != NULL) {
-                _tab(tb2);
-                printf("outfile: %s%s%s\n", CLR_DATA, tree->outfile, CLR_0);
-                _tab(tb2);
-                printf("outmode: %s%c%s\n", CLR_DATA, tree->outmode, CLR_0);
-            }
-            _tab(tb2);
-            printf("backgrnd: %s%hi%s\n", CLR_DATA, tree->backgrnd, CLR_0);
-            if (tree->psubcmd != NULL) {
-                _tab(tb2);
-                printf("psubcmd: ");
-                _st_print(tree->psubcmd, to_print_all, tabs + 1);
-            }
-            if (tree->pipe != NULL) {
-                _tab(tb2);
-                printf("pipe: ");
-                _st_print(tree->pipe, to_print_all, tabs + 1);
-            }
-            if (tree->next != NULL) {
-                _tab(tb2);
-                printf("next: ");
-                _st_print(tree->next, to_print_all, tabs + 1);
-                _tab(tb2);
-                printf("nextmode: %s%hi%s\n", CLR_DATA, tree->nextmode, CLR_0);
-            }
         }
-
-        _tab(tb);
+        if (to_print_all) {
+            _tab(tabs);
+            printf("timed: %s%hi%s\n", CLR_DATA, tree->timed, CLR_0);
+        }
+        _tab(fr->tabs);
         printf("}\n");
+        --stack->depth;
+        return;
     }
-
-    free(tb);
-    free(tb2);
 }
 
 void
 st_print(ShTree *tree, int to_print_all)
 {
-    _st_print(tree, to_print_all, 0);
-}
-
-void
-st_delete(ShTree *tree)
-{
-    if (tree == NULL) {
-        return;
-    }
-
-    strarr_del(&(tree->argv));
-    if (tree->infile != NULL) {
-        free(tree->infile);
-    }
-    if (tree->outfile != NULL) {
-        free(tree->outfile);
+    StStack stack = { NULL, 0, 0 };
+    _st_push(&stack, tree, NULL, 0);
+    while (stack.depth > 0) {
+        _st_print_step(&stack, stack.frames + stack.depth - 1, to_print_all);
     }
-    st_delete(tree->psubcmd);
-    st_delete(tree->pipe);
-    st_delete(tree->next);
-    free(tree);
+    free(stack.frames);
 }
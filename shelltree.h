@@ -1,10 +1,17 @@
 #ifndef SHELLTREE_H
 #define SHELLTREE_H
 
-enum OUTMODES /* Values of ShTree.outmode */
+#include <stdio.h>
+#include "arena.h"
+
+enum REDIRMODES /* Values of Redir.mode */
 {
-    OM_WR = 'w', /* Write */
-    OM_APP = 'a', /* Append */
+    RD_IN = '<', /* n<file: opens file for reading (n is 0 by default) */
+    RD_OUT = 'w', /* n>file: opens file for writing (n is 1 by default) */
+    RD_APP = 'a', /* n>>file: opens file for appending (n is 1 by default) */
+    RD_RDWR = '+', /* n<>file: opens file for reading and writing (n is 0 by default) */
+    RD_DUP = '&', /* n>&m or n<&m: makes n a copy of descriptor m (n is 1 or 0 by default) */
+    RD_STR = 's', /* n<<<word: input is the word and a line feed (n is 0 by default) */
 };
 
 enum BACKGRND /* Values of ShTree.backgrnd */
@@ -20,35 +27,66 @@ enum NEXTMODES /* Values of ShTree.nextmode */
     NM_ANY = 3, /* Anyway */
 };
 
+typedef struct redir Redir;
+struct redir
+{
+    int fd; /* Redirected descriptor */
+    char mode; /* Mode of redirection */
+    char *word; /* File, number of source descriptor or here-string */
+    Redir *next; /* Next redirection of the command (they are applied in order) */
+};
+
 typedef struct cmd_inf ShTree;
 struct cmd_inf
 {
     char **argv; /* Command and arguments */
-    char *infile; /* Input file */
-    char *outfile; /* Output file */
-    char outmode; /* Open mode of output file */
+    Redir *redirs; /* Redirections in order of command line */
     short backgrnd; /* Whether to execute in background mode */
     ShTree *psubcmd; /* Commands in brackets */
+    short subshell; /* Whether psubcmd is executed in a subshell (is in brackets) */
     ShTree *pipe; /* Pipe command */
     ShTree *next; /* Next command */
     short nextmode; /* Whether next command should be executed after success or fail */
+    short timed; /* Whether times of the pipeline are printed (reserved word "time") */
 };
 
-/* Creates and returns ShTree with given field values */
-ShTree * st_create(char **argv, char *infile, char *outfile, char outmode, short backgrnd,
+/* All nodes of ShTree and their fields are allocated in an arena and are freed with it */
+
+/* Pool of nodes: nodes are taken from blocks of growing size allocated in an arena,
+ * so a tree of n nodes takes O(log n) arena allocations */
+typedef struct st_pool StPool;
+struct st_pool
+{
+    Arena *ar; /* Arena of blocks */
+    ShTree *free; /* The first free node of the current block */
+    int left; /* Number of free nodes in the current block */
+    int block; /* Number of nodes in the current block */
+};
+
+/* Initializes pool '*pool' of nodes in arena 'ar' */
+void stp_init(StPool *pool, Arena *ar);
+
+/* Creates from pool 'pool' and returns ShTree with given field values;
+ * the node takes ownership of 'argv', the redirections, the strings and the subtrees, nothing is copied:
+ * they must be allocated in the arena of the pool and must not be a part of another tree */
+ShTree * st_make(StPool *pool, char **argv, Redir *redirs, short backgrnd,
+        ShTree *psubcmd, ShTree *pipe, ShTree *next, short nextmode);
+
+/* Creates in arena 'ar' and returns ShTree with copies of given field values (redirections and subtrees are copied deeply) */
+ShTree * st_create(Arena *ar, char **argv, Redir *redirs, short backgrnd,
         ShTree *psubcmd, ShTree *pipe, ShTree *next, short nextmode);
 
-/* Creates and returns empty ShTree */
-ShTree * st_init(void);
+/* Creates in arena 'ar' and returns empty ShTree */
+ShTree * st_init(Arena *ar);
+
+/* Returns a copy of ShTree allocated in arena 'ar' */
+ShTree * st_copy(Arena *ar, ShTree *tree);
 
-/* Returns a copy of ShTree */
-ShTree * st_copy(ShTree *tree);
+/* Prints redirections 'rd' to 'f' as in command line (e.g. " 2> file 2>&1") */
+void rd_fprint(FILE *f, Redir *rd);
 
 /* Prints ShTree
  * If to_print_all is set on 0, prints only non-empty fields of tree; otherwise prints all fields */
 void st_print(ShTree *tree, int to_print_all);
 
-/* Deletes ShTree */
-void st_delete(ShTree *tree);
-
 #endif
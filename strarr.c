@@ -4,40 +4,111 @@
 #include <assert.h>
 #include "strarr.h"
 
+enum
+{
+    CAP_MIN = 8, /* Capacity of a new array */
+};
+
+/* Header which is stored before the first element of array */
+typedef struct
+{
+    int len; /* Number of elements */
+    int cap; /* Number of elements that fit in allocated memory (without terminator) */
+    Arena *ar; /* Arena where the array is allocated or NULL */
+} StrarrHdr;
+
+/* Returns header of array 'arr' */
+#define HDR(arr) ((StrarrHdr *)(arr) - 1)
+
+/* The function allocates array with capacity 'cap' in arena 'ar' (or by malloc if 'ar' is NULL) and returns it */
+char ** _strarr_alloc(int cap, Arena *ar);
+
+/* The function allocates a copy of string 'str' in arena 'ar' (or by malloc if 'ar' is NULL) */
+char * _strarr_strdup(const char *str, Arena *ar);
+
 char **
-strarr_init(void)
+_strarr_alloc(int cap, Arena *ar)
 {
-    char **arr = calloc(1, sizeof(*arr));
+    const size_t size = sizeof(StrarrHdr) + (cap + 1) * sizeof(char *);
+    StrarrHdr *hdr = ar == NULL ? malloc(size) : ar_alloc(ar, size);
+    hdr->len = 0;
+    hdr->cap = cap;
+    hdr->ar = ar;
+    char **arr = (char **)(hdr + 1);
     arr[0] = NULL; /* Adds array terminator */
     return arr;
 }
 
+char *
+_strarr_strdup(const char *str, Arena *ar)
+{
+    if (ar != NULL) {
+        return ar_strdup(ar, str);
+    }
+    const int str_len = strlen(str);
+    char *copy = malloc(str_len + 1);
+    memcpy(copy, str, str_len + 1);
+    return copy;
+}
+
+char **
+strarr_init(void)
+{
+    return _strarr_alloc(CAP_MIN, NULL);
+}
+
+char **
+strarr_init_ar(Arena *ar)
+{
+    assert(ar != NULL);
+
+    return _strarr_alloc(CAP_MIN, ar);
+}
+
 void
-strarr_add(char ***parr, const char *str)
+strarr_reserve(char ***parr, int count)
+{
+    assert(parr != NULL);
+    assert(*parr != NULL);
+
+    StrarrHdr *hdr = HDR(*parr);
+    if (count <= hdr->cap) {
+        return;
+    }
+    /* Grows geometrically, so a sequence of additions costs amortized O(1) per element */
+    int cap = hdr->cap * 2;
+    if (cap < count) {
+        cap = count;
+    }
+    const size_t old_size = sizeof(*hdr) + (hdr->cap + 1) * sizeof(char *);
+    const size_t new_size = sizeof(*hdr) + (cap + 1) * sizeof(char *);
+    hdr = hdr->ar == NULL ? realloc(hdr, new_size) : ar_realloc(hdr->ar, hdr, old_size, new_size);
+    hdr->cap = cap;
+    *parr = (char **)(hdr + 1);
+}
+
+void
+strarr_push(char ***parr, char *str)
 {
     assert(parr != NULL);
     assert(*parr != NULL);
     assert(str != NULL);
 
+    strarr_reserve(parr, HDR(*parr)->len + 1);
     char **arr = *parr;
-    const int arr_len = strarr_len(arr);
-    /* Creates tmp array with one more element then 'arr' has */
-    char **tmp = calloc(arr_len + 2, sizeof(*tmp));
-    /* Copies 'arr' to 'tmp' */
-    int i;
-    for (i = 0; i < arr_len; ++i) {
-        const int str_len = strlen(arr[i]);
-        tmp[i] = calloc(str_len + 1, sizeof(**tmp));
-        strcpy(tmp[i], arr[i]);
-    }
-    /* Adds new element */
-    tmp[arr_len] = calloc(strlen(str) + 1, sizeof(**tmp));
-    strcpy(tmp[arr_len], str);
-    /* Adds array terminator */
-    tmp[arr_len + 1] = NULL;
-    /* Replaces '*parr' by 'tmp' */
-    strarr_del(parr);
-    *parr = tmp;
+    StrarrHdr *hdr = HDR(arr);
+    arr[hdr->len++] = str;
+    arr[hdr->len] = NULL; /* Adds array terminator */
+}
+
+void
+strarr_add(char ***parr, const char *str)
+{
+    assert(parr != NULL);
+    assert(*parr != NULL);
+    assert(str != NULL);
+
+    strarr_push(parr, _strarr_strdup(str, HDR(*parr)->ar));
 }
 
 int
@@ -45,9 +116,7 @@ strarr_len(char **arr)
 {
     assert(arr != NULL);
 
-    register int count = -1;
-    while (arr[++count] != NULL);
-    return count;
+    return HDR(arr)->len;
 }
 
 void
@@ -72,17 +141,17 @@ strarr_cp(char **arr)
     assert(arr != NULL);
 
     const int arr_len = strarr_len(arr);
-    /* Creates new array */
-    char **new_arr = calloc(arr_len + 1, sizeof(*new_arr));
+    Arena *ar = HDR(arr)->ar;
+    /* Creates new array of the same length */
+    char **new_arr = _strarr_alloc(arr_len, ar);
     /* Copies elements */
     int i;
     for (i = 0; i < arr_len; ++i) {
-        const int str_len = strlen(arr[i]);
-        new_arr[i] = calloc(str_len + 1, sizeof(**new_arr));
-        strcpy(new_arr[i], arr[i]);
+        new_arr[i] = _strarr_strdup(arr[i], ar);
     }
     /* Adds array terminator */
     new_arr[arr_len] = NULL;
+    HDR(new_arr)->len = arr_len;
 
     return new_arr;
 }
@@ -110,10 +179,13 @@ strarr_del(char ***parr)
     assert(*parr != NULL);
 
     char **arr = *parr;
-    register int i = 0;
-    while (arr[i] != NULL) {
-        free(arr[i++]);
+    /* Memory of an array in arena is freed with the arena */
+    if (HDR(arr)->ar == NULL) {
+        register int i = 0;
+        while (arr[i] != NULL) {
+            free(arr[i++]);
+        }
+        free(HDR(arr));
     }
-    free(arr);
     *parr = NULL;
 }
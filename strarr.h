@@ -2,25 +2,43 @@
 #ifndef STRARR_H
 #define STRARR_H
 
+#include "arena.h"
+
 /* Output formats for string array */
 #define FRMT_W "%s " /* One element - one word */
 #define FRMT_L "%s\n" /* One element - one line*/
 
-typedef char **strarr; /* Array of strings */
+/* Array of strings;
+ * arrays created by strarr_init and strarr_cp keep their length and capacity in a header
+ * before the first element, so appending is amortized O(1) and strarr_len is O(1);
+ * strarr_print and strarr_find also accept any NULL-terminated array of strings */
+typedef char **strarr;
 
 /* Creates empty array and returns it */
 strarr strarr_init(void);
 
-/* Adds string 'str' to array '*parr' */
+/* Creates empty array in arena 'ar' and returns it;
+ * the array and the strings copied to it are allocated in 'ar' and are freed with it */
+strarr strarr_init_ar(Arena *ar);
+
+/* Adds a copy of string 'str' to array '*parr' */
 void strarr_add(strarr *parr, const char *str);
 
+/* Adds string 'str' to array '*parr' without copying it;
+ * the array takes ownership of 'str', so it must be allocated by malloc
+ * (or in the arena of the array, if the array is created by strarr_init_ar) */
+void strarr_push(strarr *parr, char *str);
+
+/* Reserves memory in array '*parr' for at least 'count' elements */
+void strarr_reserve(strarr *parr, int count);
+
 /* Returns number of elements in array 'arr' */
 int strarr_len(strarr arr);
 
 /* Prints array 'arr' using given format 'format' for each element */
 void strarr_print(strarr arr, const char *format);
 
-/* Creates a copy of array 'arr' and returns it */
+/* Creates a copy of array 'arr' and returns it (in the arena of 'arr', if it has one) */
 strarr strarr_cp(strarr arr);
 
 /* Finds string 'str' in array 'arr';
@@ -28,7 +46,7 @@ strarr strarr_cp(strarr arr);
  * Otherwise returns -1 */
 int strarr_find(strarr arr, const char *str);
 
-/* Deletes array '*parr' and sets it to NULL */
+/* Deletes array '*parr' and sets it to NULL (an array in arena is only forgotten) */
 void strarr_del(strarr *parr);
 
 #endif
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "timing.h"
+
+/* The function prints one line of tm_print: 'name', minutes and seconds */
+void _tm_print_line(const char *name, double sec);
+
+double
+tm_real(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double
+tm_cpu(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double
+tm_children(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_CHILDREN, &ru);
+    return tm_sec(&ru.ru_utime) + tm_sec(&ru.ru_stime);
+}
+
+double
+tm_sec(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+void
+_tm_print_line(const char *name, double sec)
+{
+    const int min = (int)(sec / 60);
+    fprintf(stderr, "%s\t%dm%.3fs\n", name, min, sec - 60 * min);
+}
+
+void
+tm_print(double real, double user, double sys)
+{
+    fputc('\n', stderr);
+    _tm_print_line("real", real);
+    _tm_print_line("user", user);
+    _tm_print_line("sys", sys);
+    fflush(stderr);
+}
@@ -0,0 +1,23 @@
+/* The module implements measurement of time: wall clock time and CPU time of the shell and of its sons;
+ * it is used by the flag of per-phase timing and by the reserved word "time" */
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <sys/time.h>
+
+/* Returns monotonic wall clock time in seconds */
+double tm_real(void);
+
+/* Returns CPU time (user and system) of the shell process in seconds */
+double tm_cpu(void);
+
+/* Returns CPU time (user and system) of the waited sons of the shell in seconds */
+double tm_children(void);
+
+/* Returns time 'tv' in seconds */
+double tm_sec(const struct timeval *tv);
+
+/* Prints real, user and system time in seconds to the standard error stream like "time" of bash */
+void tm_print(double real, double user, double sys);
+
+#endif
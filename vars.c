@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "vars.h"
+
+enum
+{
+    CAP_MIN = 64, /* Initial capacity of the table (power of 2) */
+};
+
+extern const char BASH_NAME[];
+
+/* Entry of the table */
+typedef struct
+{
+    char *pair; /* "NAME=value" (NULL for empty entry); it is the element of environment */
+    int name_len; /* Length of name */
+    unsigned hash; /* Hash of name */
+    int exported; /* Whether the variable is exported */
+} VrEntry;
+
+/* Table with open addressing and linear probing */
+VrEntry *vr_tab = NULL;
+unsigned vr_cap = 0; /* Capacity (power of 2) */
+unsigned vr_count = 0; /* Number of entries */
+
+/* Environment of commands */
+char **vr_env = NULL;
+int vr_env_dirty = 1; /* Whether exported variables have changed after vr_env was built */
+unsigned vr_path_changes = 0; /* Number of changes of PATH (it is not reset by vr_delete) */
+
+/* The function returns hash of name of length 'len' */
+unsigned _vr_hash(const char *name, int len);
+
+/* The function returns entry of 'name' of length 'len' or empty entry where it should be inserted */
+VrEntry * _vr_find(const char *name, int len, unsigned hash);
+
+/* The function returns length of name if 'str' starts with a valid name followed by '=' or by the end,
+ * otherwise returns -1 */
+int _vr_name_len(const char *str);
+
+/* The function compares entries by names (for qsort) */
+int _vr_cmp(const void *a, const void *b);
+
+/* The function prints variables (only exported ones, if 'only_exported' is set) sorted by name */
+void _vr_print(int only_exported, const char *prefix);
+
+unsigned
+_vr_hash(const char *name, int len)
+{
+    /* FNV-1a */
+    register unsigned h = 2166136261u;
+    for (register int i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+VrEntry *
+_vr_find(const char *name, int len, unsigned hash)
+{
+    register unsigned i = hash & (vr_cap - 1);
+    while (vr_tab[i].pair != NULL && (vr_tab[i].hash != hash || vr_tab[i].name_len != len ||
+            memcmp(vr_tab[i].pair, name, len) != 0)) {
+        i = (i + 1) & (vr_cap - 1);
+    }
+    return vr_tab + i;
+}
+
+int
+_vr_name_len(const char *str)
+{
+    if (!isalpha((unsigned char)str[0]) && str[0] != '_') {
+        return -1;
+    }
+    int len = 1;
+    while (isalnum((unsigned char)str[len]) || str[len] == '_') {
+        ++len;
+    }
+    return str[len] == '=' || str[len] == '\0' ? len : -1;
+}
+
+void
+vr_init(char **envp)
+{
+    for (char **env = envp; *env != NULL; ++env) {
+        const int name_len = _vr_name_len(*env);
+        if (name_len != -1 && (*env)[name_len] == '=') {
+            char name[name_len + 1];
+            memcpy(name, *env, name_len);
+            name[name_len] = '\0';
+            vr_set(name, *env + name_len + 1, 1);
+        }
+    }
+}
+
+const char *
+vr_get(const char *name, int len)
+{
+    if (vr_tab == NULL) {
+        return NULL;
+    }
+    const VrEntry *ent = _vr_find(name, len, _vr_hash(name, len));
+    return ent->pair == NULL ? NULL : ent->pair + len + 1;
+}
+
+void
+vr_set(const char *name, const char *value, int to_export)
+{
+    /* Keeps load factor not more than 1/2 */
+    if (2 * (vr_count + 1) > vr_cap) {
+        VrEntry *old = vr_tab;
+        const unsigned old_cap = vr_cap;
+        vr_cap = vr_cap == 0 ? CAP_MIN : 2 * vr_cap;
+        vr_tab = calloc(vr_cap, sizeof(*vr_tab));
+        for (unsigned i = 0; i < old_cap; ++i) {
+            if (old[i].pair != NULL) {
+                *_vr_find(old[i].pair, old[i].name_len, old[i].hash) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    const int name_len = strlen(name);
+    const unsigned hash = _vr_hash(name, name_len);
+    VrEntry *ent = _vr_find(name, name_len, hash);
+    if (ent->pair == NULL) {
+        ent->name_len = name_len;
+        ent->hash = hash;
+        ent->exported = 0;
+        ++vr_count;
+    } else {
+        free(ent->pair);
+    }
+    const int value_len = strlen(value);
+    ent->pair = malloc(name_len + value_len + 2);
+    memcpy(ent->pair, name, name_len);
+    ent->pair[name_len] = '=';
+    memcpy(ent->pair + name_len + 1, value, value_len + 1);
+    ent->exported |= to_export;
+    vr_env_dirty |= ent->exported;
+    vr_path_changes += strcmp(name, "PATH") == 0;
+}
+
+void
+vr_unset(const char *name)
+{
+    if (vr_tab == NULL) {
+        return;
+    }
+    const int name_len = strlen(name);
+    VrEntry *ent = _vr_find(name, name_len, _vr_hash(name, name_len));
+    if (ent->pair == NULL) {
+        return;
+    }
+    vr_env_dirty |= ent->exported;
+    vr_path_changes += strcmp(name, "PATH") == 0;
+    free(ent->pair);
+    ent->pair = NULL;
+    --vr_count;
+
+    /* Moves back the following entries of the cluster, so that lookups do not stop at the hole */
+    register unsigned hole = ent - vr_tab;
+    register unsigned i = (hole + 1) & (vr_cap - 1);
+    while (vr_tab[i].pair != NULL) {
+        const unsigned home = vr_tab[i].hash & (vr_cap - 1);
+        /* The entry can fill the hole if its home is not in (hole, i] cyclically */
+        if (((i - home) & (vr_cap - 1)) >= ((i - hole) & (vr_cap - 1))) {
+            vr_tab[hole] = vr_tab[i];
+            vr_tab[i].pair = NULL;
+            hole = i;
+        }
+        i = (i + 1) & (vr_cap - 1);
+    }
+}
+
+unsigned
+vr_path_gen(void)
+{
+    return vr_path_changes;
+}
+
+char **
+vr_envp(void)
+{
+    if (!vr_env_dirty) {
+        return vr_env;
+    }
+    /* Strings are not copied: environment refers to pairs of entries */
+    int count = 0;
+    for (unsigned i = 0; i < vr_cap; ++i) {
+        count += vr_tab[i].pair != NULL && vr_tab[i].exported;
+    }
+    vr_env = realloc(vr_env, (count + 1) * sizeof(*vr_env));
+    int n = 0;
+    for (unsigned i = 0; i < vr_cap; ++i) {
+        if (vr_tab[i].pair != NULL && vr_tab[i].exported) {
+            vr_env[n++] = vr_tab[i].pair;
+        }
+    }
+    vr_env[n] = NULL;
+    vr_env_dirty = 0;
+    return vr_env;
+}
+
+int
+_vr_cmp(const void *a, const void *b)
+{
+    const char *pa = *(char * const *)a;
+    const char *pb = *(char * const *)b;
+    const int la = strchr(pa, '=') - pa;
+    const int lb = strchr(pb, '=') - pb;
+    const int res = memcmp(pa, pb, la < lb ? la : lb);
+    return res != 0 ? res : la - lb;
+}
+
+void
+_vr_print(int only_exported, const char *prefix)
+{
+    char **pairs = malloc((vr_count + 1) * sizeof(*pairs));
+    int n = 0;
+    for (unsigned i = 0; i < vr_cap; ++i) {
+        if (vr_tab[i].pair != NULL && (vr_tab[i].exported || !only_exported)) {
+            pairs[n++] = vr_tab[i].pair;
+        }
+    }
+    qsort(pairs, n, sizeof(*pairs), _vr_cmp);
+    for (int i = 0; i < n; ++i) {
+        const char *eq = strchr(pairs[i], '=');
+        printf("%s%.*s=\"%s\"\n", prefix, (int)(eq - pairs[i]), pairs[i], eq + 1);
+    }
+    free(pairs);
+}
+
+int
+vr_export(char **argv)
+{
+    if (argv[1] == NULL) {
+        _vr_print(1, "export ");
+        return 0;
+    }
+
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        const int name_len = _vr_name_len(argv[i]);
+        if (name_len == -1) {
+            fprintf(stderr, "%s: export: `%s': not a valid identifier\n", BASH_NAME, argv[i]);
+            ret = 1;
+            continue;
+        }
+        char name[name_len + 1];
+        memcpy(name, argv[i], name_len);
+        name[name_len] = '\0';
+        if (argv[i][name_len] == '=') {
+            vr_set(name, argv[i] + name_len + 1, 1);
+        } else {
+            /* An existing variable is exported with its value */
+            VrEntry *ent = vr_tab == NULL ? NULL : _vr_find(name, name_len, _vr_hash(name, name_len));
+            if (ent != NULL && ent->pair != NULL && !ent->exported) {
+                ent->exported = 1;
+                vr_env_dirty = 1;
+            }
+        }
+    }
+    return ret;
+}
+
+int
+vr_unset_builtin(char **argv)
+{
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        if (_vr_name_len(argv[i]) == -1 || strchr(argv[i], '=') != NULL) {
+            fprintf(stderr, "%s: unset: `%s': not a valid identifier\n", BASH_NAME, argv[i]);
+            ret = 1;
+            continue;
+        }
+        vr_unset(argv[i]);
+    }
+    return ret;
+}
+
+int
+vr_set_builtin(char **argv)
+{
+    if (argv[1] == NULL) {
+        _vr_print(0, "");
+        return 0;
+    }
+
+    int ret = 0;
+    for (int i = 1; argv[i] != NULL; ++i) {
+        const int name_len = _vr_name_len(argv[i]);
+        if (name_len == -1 || argv[i][name_len] != '=') {
+            fprintf(stderr, "%s: set: `%s': not a valid assignment\n", BASH_NAME, argv[i]);
+            ret = 1;
+            continue;
+        }
+        char name[name_len + 1];
+        memcpy(name, argv[i], name_len);
+        name[name_len] = '\0';
+        vr_set(name, argv[i] + name_len + 1, 0);
+    }
+    return ret;
+}
+
+void
+vr_delete(void)
+{
+    for (unsigned i = 0; i < vr_cap; ++i) {
+        free(vr_tab[i].pair);
+    }
+    free(vr_tab);
+    free(vr_env);
+    vr_tab = NULL;
+    vr_env = NULL;
+    vr_cap = 0;
+    vr_count = 0;
+    vr_env_dirty = 1;
+}
@@ -0,0 +1,45 @@
+/* The module implements the table of shell variables (hash table from names to values);
+ * exported variables make environment of commands, which is rebuilt only after they change */
+#ifndef VARS_H
+#define VARS_H
+
+/* Fills the table with variables of environment 'envp' (they are exported) */
+void vr_init(char **envp);
+
+/* Returns value of variable 'name' of length 'len' (it needs no terminator) or NULL if it is not set;
+ * the value is valid until the variable is changed */
+const char * vr_get(const char *name, int len);
+
+/* Sets variable 'name' to 'value'; if 'to_export' is set, the variable is exported,
+ * otherwise it keeps its export flag (a new variable is not exported) */
+void vr_set(const char *name, const char *value, int to_export);
+
+/* Removes variable 'name' */
+void vr_unset(const char *name);
+
+/* Returns number of changes of PATH (setting or removing it); the table of command paths is reset
+ * when it changes, so that lookups of commands do not compare PATH itself */
+unsigned vr_path_gen(void);
+
+/* Returns environment of commands: NULL-terminated array of "NAME=value" of exported variables;
+ * it is rebuilt only if exported variables have changed since the previous call */
+char ** vr_envp(void);
+
+/* Executes builtin "export":
+ * without arguments prints exported variables,
+ * "export name=value..." sets and exports variables, "export name..." exports existing variables;
+ * returns exit status */
+int vr_export(char **argv);
+
+/* Executes builtin "unset": "unset name..." removes variables; returns exit status */
+int vr_unset_builtin(char **argv);
+
+/* Executes builtin "set":
+ * without arguments prints all variables, "set name=value..." sets variables;
+ * returns exit status */
+int vr_set_builtin(char **argv);
+
+/* Frees the table */
+void vr_delete(void);
+
+#endif